@@ -10,14 +10,19 @@
 #include "async_task.h"
 #include "usb_boot_device.h"
 #include "usb_msc.h"
+#include "virtual_disk.h"
 #include "boot/picoboot.h"
 #include "hardware/sync.h"
+#include "xxd_render.h"
+#include "xip_arena.h"
+#include "live_export.h"
 
 //#define NO_ASYNC
 //#define NO_ROM_READ
 
 CU_REGISTER_DEBUG_PINS(flash)
 
+#ifndef USE_LIVE_EXPORT
 static uint32_t _do_flash_enter_cmd_xip();
 static uint32_t _do_flash_exit_xip();
 static uint32_t _do_flash_erase_sector(uint32_t addr);
@@ -105,7 +110,7 @@ static uint32_t _do_flash_page_read(uint32_t addr, uint8_t *data) {
 static bool _is_address_safe_for_vectoring(uint32_t addr) {
     // not we are inclusive at end to save arithmentic, and since we always checking for non empty ranges
     return is_address_ram(addr) &&
-           (addr < FLASH_VALID_BLOCKS_BASE || addr > FLASH_VALID_BLOCKS_BASE + FLASH_BITMAPS_SIZE);
+           (addr < FLASH_VALID_BLOCKS_BASE || addr > FLASH_VALID_BLOCKS_BASE + FLASH_WORKSPACE_SIZE);
 }
 
 static uint8_t _last_mutation_source;
@@ -117,6 +122,11 @@ static uint32_t _execute_task(struct async_task *task) {
         return PICOBOOT_REBOOTING;
     }
     uint type = task->type;
+#ifdef USE_XXD_RENDER
+    // anything but reading RAM may change what core1 renders, or take away
+    // the flash it runs from
+    if (type != AT_READ || !is_address_ram(task->transfer_addr)) xxd_render_stop();
+#endif
     if (type & AT_VECTORIZE_FLASH) {
         if (task->transfer_addr & 1u) {
             return PICOBOOT_BAD_ALIGNMENT;
@@ -213,6 +223,37 @@ static uint32_t _execute_task(struct async_task *task) {
     }
     return PICOBOOT_OK;
 }
+#else
+// The application owns its flash and RAM (live_export.h): reads only, of flash
+// through XIP around the cache, so as not to disturb what the application has
+// in it, and of SRAM not XIP SRAM, which is the cache. Leaving XIP (which
+// picotool asks for before reading flash) and back do nothing.
+static uint32_t _execute_task(struct async_task *task) {
+    uint type = task->type;
+    // nowhere can be written, erased or run
+    if (type & (AT_WRITE | AT_FLASH_ERASE | AT_EXEC | AT_VECTORIZE_FLASH)) return PICOBOOT_INVALID_ADDRESS;
+    if (type & AT_EXCLUSIVE) {
+        async_disable_queue(&virtual_disk_queue, task->exclusive_param);
+        if (task->exclusive_param == EXCLUSIVE_AND_EJECT) {
+            msc_eject();
+        }
+    }
+    if (!(type & AT_READ)) return PICOBOOT_OK;
+    uint32_t addr = task->transfer_addr, end = addr + task->data_length;
+    if (addr >= SRAM_BASE && end <= SRAM_END) {
+        live_export_copy(task->data, (const void *) addr, task->data_length);
+    } else if (is_address_flash(addr) && is_address_flash(end)) {
+        memcpy(task->data, (const void *) (addr - XIP_MAIN_BASE + XIP_NOCACHE_NOALLOC_BASE), task->data_length);
+#ifndef NO_ROM_READ
+    } else if (is_address_rom(addr) && is_address_rom(end)) {
+        memcpy(task->data, (const void *) addr, task->data_length);
+#endif
+    } else {
+        return PICOBOOT_INVALID_ADDRESS;
+    }
+    return PICOBOOT_OK;
+}
+#endif
 
 // just put this here in case it is worth noinlining - not atm
 static void _task_copy(struct async_task *to, struct async_task *from) {
@@ -274,6 +315,9 @@ void execute_task(struct async_task_queue *queue, struct async_task *task) {
     else
         task->result = _execute_task(task);
     uint32_t save = save_and_disable_interrupts();
+    // anything but a read may have changed what the disk shows (REGS.TXT,
+    // BACKTRAC.TXT, the crash ring...)
+    if (task->type & ~AT_READ) vd_overlay_flush();
     _call_task_complete(task);
     restore_interrupts(save);
 }
@@ -287,7 +331,9 @@ static bool _worker_started;
 static struct async_task _worker_task;
 
 void __attribute__((noreturn)) async_task_worker() {
+#ifndef USE_LIVE_EXPORT
     flash_funcs = &default_flash_funcs;
+#endif
 #ifndef NDEBUG
     _worker_started = true;
 #endif
@@ -299,6 +345,11 @@ void __attribute__((noreturn)) async_task_worker() {
         else if (dequeue_task(&picoboot_queue, &_worker_task)) {
             execute_task(&picoboot_queue, &_worker_task);
         }
+#endif
+#ifdef USE_GDB_STUB
+        else if (dequeue_task(&gdb_stub_queue, &_worker_task)) {
+            execute_task(&gdb_stub_queue, &_worker_task);
+        }
 #endif
         else {
             __wfe();
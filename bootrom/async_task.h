@@ -91,11 +91,17 @@ static inline void reset_queue(struct async_task_queue *queue) {
 }
 
 // async task needs to know where the flash bitmap is so it can avoid it
-#ifndef USB_BOOT_EXPANDED_RUNTIME
+#ifdef USE_LIVE_EXPORT
+// the application is using XIP SRAM as cache (live_export.h)
+extern uint32_t live_export_workspace[];
+#define FLASH_VALID_BLOCKS_BASE ((uintptr_t) live_export_workspace)
+#elif !defined(USB_BOOT_EXPANDED_RUNTIME)
 #define FLASH_VALID_BLOCKS_BASE XIP_SRAM_BASE
 #else
 #define FLASH_VALID_BLOCKS_BASE (SRAM_BASE + 96 * 1024)
 #endif
-#define FLASH_BITMAPS_SIZE (XIP_SRAM_END - XIP_SRAM_BASE)
+// everything from FLASH_VALID_BLOCKS_BASE that the flash code uses as workspace
+// (the UF2 bitmaps, then the XIP arena, see xip_arena.h)
+#define FLASH_WORKSPACE_SIZE (XIP_SRAM_END - XIP_SRAM_BASE)
 
 #endif //ASYNC_TASK_H_
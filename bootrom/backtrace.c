@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <sys/param.h>
+#include "backtrace.h"
+#include "crashdump.h"
+#include "xip_arena.h"
+
+#define bt (&xip_overlay->backtrace)
+
+// A line is its kind, its core, and for a stack entry where it is, as an
+// offset into SRAM
+#define LINE_KIND_LSB 30
+#define LINE_CORE_LSB 29
+#define LINE_SLOT_BITS 0x1fffffu
+enum line_kind {
+    LINE_PC,
+    LINE_LR,
+    LINE_BL,
+    LINE_BLX,
+};
+static_assert(SRAM_END - SRAM_BASE <= LINE_SLOT_BITS, "");
+
+static void _add_line(enum line_kind kind, uint core, uint32_t slot) {
+    if (bt->count < BACKTRACE_MAX_LINES) {
+        bt->line[bt->count++] = kind << LINE_KIND_LSB | core << LINE_CORE_LSB | (slot - SRAM_BASE);
+    }
+}
+
+// LINE_BL or LINE_BLX if word is a Thumb address in [start, end) just after
+// one; LINE_PC otherwise
+static enum line_kind _call_kind(uint32_t word, uint32_t start, uint32_t end) {
+    uint32_t ret = word & ~1u;
+    if (!(word & 1u) || ret < start + 4 || ret >= end) return LINE_PC;
+    // the XIP cache is off (its SRAM is our workspace), so read around it
+    const uint16_t *p = (const uint16_t *) (ret - XIP_BASE + XIP_NOCACHE_NOALLOC_BASE);
+    // BL is two halfwords, 11110xxx... then 11x1xxxx...
+    if ((p[-2] & 0xf800u) == 0xf000u && (p[-1] & 0xd000u) == 0xd000u) return LINE_BL;
+    // BLX Rm is 010001111mmmm000
+    if ((p[-1] & 0xff87u) == 0x4780u) return LINE_BLX;
+    return LINE_PC;
+}
+
+static void _scan_core(const struct crashdump_block *block, uint core, uint32_t start, uint32_t end) {
+    const struct crashdump_regs *regs = &block->core[core];
+    if (regs->state == CRASHDUMP_STATE_NONE) return;
+    _add_line(LINE_PC, core, SRAM_BASE);
+    _add_line(LINE_LR, core, SRAM_BASE);
+    uint32_t sp = regs->r[13], top = regs->stack_top;
+    if ((sp & 3u) || sp < SRAM_BASE || sp >= SRAM_END) return;
+    // stack_top is the main stack's, and older capture libraries leave it
+    // uninitialized
+    if ((regs->exc_return & 4u) || (top & 3u) || top <= sp || top > SRAM_END) {
+        top = MIN(sp + BACKTRACE_STACK_WINDOW, SRAM_END);
+    }
+    top = MIN(top, sp + BACKTRACE_STACK_MAX);
+    for (uint32_t slot = sp; slot < top; slot += 4) {
+        enum line_kind kind = _call_kind(*(const uint32_t *) slot, start, end);
+        if (kind != LINE_PC) _add_line(kind, core, slot);
+    }
+}
+
+static void _scan() {
+    bt->count = 0;
+    const struct crashdump_block *block = crashdump_get_block();
+    if (!block) return;
+    uint32_t start = XIP_BASE, end = XIP_NOALLOC_BASE;
+    // all of flash if the application didn't say
+    if (block->size >= CRASHDUMP_BLOCK_SIZE && XIP_BASE <= block->text_start && block->text_start < block->text_end &&
+        block->text_end <= XIP_NOALLOC_BASE) {
+        start = block->text_start;
+        end = block->text_end;
+    }
+    for (uint i = 0; i < CRASHDUMP_NUM_CORES; i++) {
+        _scan_core(block, i ? block->crashed_core ^ 1u : block->crashed_core & 1u, start, end);
+    }
+}
+
+void backtrace_flush() {
+    bt->count = BACKTRACE_UNSCANNED;
+}
+
+uint32_t backtrace_size() {
+    if (bt->count == BACKTRACE_UNSCANNED) _scan();
+    return bt->count * BACKTRACE_LINE;
+}
+
+static void _render_line(uint8_t *p, uint32_t line, const struct crashdump_block *block) {
+    static const char kinds[][4] = {"   ", "   ", "bl ", "blx"};
+    enum line_kind kind = line >> LINE_KIND_LSB;
+    uint core = (line >> LINE_CORE_LSB) & 1u;
+    const struct crashdump_regs *regs = &block->core[core];
+    for (uint i = 0; i < BACKTRACE_LINE - 1; i++) p[i] = ' ';
+    p[BACKTRACE_LINE - 1] = '\n';
+    memcpy(p, "core ", 5);
+    p[5] = '0' + core;
+    uint32_t value;
+    if (kind == LINE_PC || kind == LINE_LR) {
+        memcpy(p + 8, kind == LINE_PC ? "pc" : "lr", 2);
+        value = regs->r[kind == LINE_PC ? 15 : 14];
+    } else {
+        uint32_t slot = SRAM_BASE + (line & LINE_SLOT_BITS);
+        memcpy(p + 8, "sp+", 3);
+        hex(p + 11, slot - regs->r[13], 5);
+        // the call itself
+        value = (*(const uint32_t *) slot & ~1u) - (kind == LINE_BL ? 4 : 2);
+    }
+    hex(p + 18, value, 8);
+    memcpy(p + 28, kinds[kind], 3);
+}
+
+void backtrace_read(uint32_t file_sector, uint8_t *buf) {
+    const struct crashdump_block *block = crashdump_get_block();
+    uint32_t first = file_sector * (SECTOR_SIZE / BACKTRACE_LINE);
+    if (!block || backtrace_size() <= first * BACKTRACE_LINE) return;
+    for (uint32_t n = first; n < bt->count && n < first + SECTOR_SIZE / BACKTRACE_LINE; n++) {
+        _render_line(buf + (n - first) * BACKTRACE_LINE, bt->line[n], block);
+    }
+}
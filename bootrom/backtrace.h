@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _BACKTRACE_H
+#define _BACKTRACE_H
+
+#include "runtime.h"
+
+// BACKTRACE.TXT: for each captured core (the crashed one first), its pc and
+// lr, then the words on its stack that look like return addresses, i.e. point
+// into the application's code just after a BL or a BLX. One line each:
+//
+//      core 1  pc        10001234     \n
+//      core 1  sp+00024  10000f36  bl \n
+//
+// where the stack ones give the address of the call, ready for addr2line.
+//
+// The scan is done on first use, and its result (which lines, not their text)
+// kept in the XIP overlay (xip_arena.h) until flushed.
+
+#define BACKTRACE_LINE 32
+#define BACKTRACE_MAX_LINES 64
+// how much stack to scan: from the SP up to the top the capture block gives,
+// or BACKTRACE_STACK_WINDOW without one, and no more than BACKTRACE_STACK_MAX
+#define BACKTRACE_STACK_WINDOW 1024u
+#define BACKTRACE_STACK_MAX (8u * 1024u)
+#define BACKTRACE_UNSCANNED 0xffffffffu
+
+struct backtrace {
+    // lines, or BACKTRACE_UNSCANNED
+    uint32_t count;
+    // what each line is (see backtrace.c)
+    uint32_t line[BACKTRACE_MAX_LINES];
+};
+
+// Scan again next time, as SRAM or flash may have changed
+void backtrace_flush(void);
+
+// Of BACKTRACE.TXT, scanning if need be
+uint32_t backtrace_size(void);
+
+// One sector of BACKTRACE.TXT; buf must be zeroed
+void backtrace_read(uint32_t file_sector, uint8_t *buf);
+
+#endif
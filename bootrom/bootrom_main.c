@@ -20,6 +20,8 @@
 
 #include "async_task.h"
 #include "bootrom_crc32.h"
+#include "crashdump.h"
+#include "crash_ring.h"
 #include "runtime.h"
 #include "hardware/structs/usb.h"
 
@@ -63,6 +65,32 @@ static inline void delay(uint32_t count) {
 // return from this function. This is because boards which are not designed to
 // use USB will still enter the USB bootcode when booted with a blank flash.
 
+// A crashed application has usually left the crystal and a PLL running. If
+// either PLL is still locked with a 48 MHz output (from the 12 MHz crystal),
+// return it so we can use it as is, rather than waiting for the XOSC and a
+// PLL lock again.
+static pll_hw_t *_usb_clock_warm_pll() {
+    const uint32_t xosc_ok = XOSC_STATUS_ENABLED_BITS | XOSC_STATUS_STABLE_BITS;
+    if ((xosc_hw->status & xosc_ok) != xosc_ok)
+        return NULL;
+    for (uint i = 0; i < 2; i++) {
+        pll_hw_t *pll = i ? pll_sys_hw : pll_usb_hw;
+        if (resets_hw->reset & (i ? RESETS_RESET_PLL_SYS_BITS : RESETS_RESET_PLL_USB_BITS))
+            continue;
+        if ((pll->cs & (PLL_CS_LOCK_BITS | PLL_CS_BYPASS_BITS)) != PLL_CS_LOCK_BITS)
+            continue;
+        if (pll->pwr & (PLL_PWR_PD_BITS | PLL_PWR_VCOPD_BITS | PLL_PWR_POSTDIVPD_BITS))
+            continue;
+        uint32_t refdiv = (pll->cs & PLL_CS_REFDIV_BITS) >> PLL_CS_REFDIV_LSB;
+        uint32_t postdiv1 = (pll->prim & PLL_PRIM_POSTDIV1_BITS) >> PLL_PRIM_POSTDIV1_LSB;
+        uint32_t postdiv2 = (pll->prim & PLL_PRIM_POSTDIV2_BITS) >> PLL_PRIM_POSTDIV2_LSB;
+        // 12 MHz * fbdiv / (refdiv * postdiv1 * postdiv2) == 48 MHz
+        if (pll->fbdiv_int == 4 * refdiv * postdiv1 * postdiv2)
+            return pll;
+    }
+    return NULL;
+}
+
 static void _usb_clock_setup() {
     // First make absolutely sure clk_ref is running: needed for resuscitate,
     // and to run clk_sys while configuring sys PLL. Assume that rosc is not
@@ -90,6 +118,10 @@ static void _usb_clock_setup() {
     clocks_hw->clk[clk_sys].div = 0x100; // int 1 frac 0
     clocks_hw->clk[clk_usb].div = 0x100;
 
+    pll_hw_t *warm_pll = _usb_clock_warm_pll();
+    if (warm_pll)
+        goto switch_to_pll;
+
     // Try to get the crystal running. If no crystal is present, XI should be
     // grounded, so STABLE counter will never complete. Poor designs might
     // leave XI floating, in which case we may eventually drop through... in
@@ -122,12 +154,23 @@ static void _usb_clock_setup() {
     // Power up post-dividers, which ungates PLL final output
     hw_clear_bits(&pll_sys_hw->pwr, PLL_PWR_POSTDIVPD_BITS);
 
-    // Glitchy switch of clk_usb, clk_sys aux to sys PLL output.
-    clocks_hw->clk[clk_sys].ctrl = 0;
-    clocks_hw->clk[clk_usb].ctrl =
-            CLOCKS_CLK_USB_CTRL_ENABLE_BITS |
-            (CLOCKS_CLK_USB_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS
-                    << CLOCKS_CLK_USB_CTRL_AUXSRC_LSB);
+    switch_to_pll:
+    // Glitchy switch of clk_usb, clk_sys aux to sys PLL output (or the warm
+    // USB PLL).
+    if (warm_pll == pll_usb_hw) {
+        clocks_hw->clk[clk_sys].ctrl =
+                CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB << CLOCKS_CLK_SYS_CTRL_AUXSRC_LSB;
+        clocks_hw->clk[clk_usb].ctrl =
+                CLOCKS_CLK_USB_CTRL_ENABLE_BITS |
+                (CLOCKS_CLK_USB_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB
+                        << CLOCKS_CLK_USB_CTRL_AUXSRC_LSB);
+    } else {
+        clocks_hw->clk[clk_sys].ctrl = 0;
+        clocks_hw->clk[clk_usb].ctrl =
+                CLOCKS_CLK_USB_CTRL_ENABLE_BITS |
+                (CLOCKS_CLK_USB_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS
+                        << CLOCKS_CLK_USB_CTRL_AUXSRC_LSB);
+    }
 
     // Glitchless switch of clk_sys to aux source (sys PLL)
     hw_set_bits(&clocks_hw->clk[clk_sys].ctrl, CLOCKS_CLK_SYS_CTRL_SRC_BITS);
@@ -155,12 +198,17 @@ static __noinline __attribute__((noreturn)) void _usb_boot(uint32_t _usb_activit
     // this is where the BSS is so clear it
     memset0(usb_dpram, USB_DPRAM_SIZE);
 
+#ifdef USE_LOG
+    // in XIP SRAM, so only once the cache is off
+    log_init();
+#endif
+
     // now we can finally initialize these
 #ifdef USE_BOOTROM_GPIO
     usb_activity_gpio_pin_mask = _usb_activity_gpio_pin_mask;
 #endif
 
-    usb_boot_device_init(disable_interface_mask);
+    usb_boot_device_start(disable_interface_mask);
 
     // worker to run tasks on this thread (never returns); Note: USB code is IRQ driven
     // this thunk switches stack into USB DPRAM then calls async_task_worker
@@ -179,6 +227,29 @@ void __attribute__((noreturn)) reset_usb_boot(uint32_t _usb_activity_gpio_pin_ma
 }
 
 int main() {
+    if (watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] == CRASHDUMP_MAGIC) {
+        // The crash capture leaves the RESETS block alone so its PLLs survive
+        // (see _usb_clock_setup); stop everything else that could still be
+        // writing to the SRAM we are about to serve. Not the QSPI pins though,
+        // as we are running from flash.
+        reset_block_noinline(RESETS_RESET_BITS & ~(RESETS_RESET_PLL_SYS_BITS | RESETS_RESET_PLL_USB_BITS |
+                                                   RESETS_RESET_IO_QSPI_BITS | RESETS_RESET_PADS_QSPI_BITS));
+#ifdef USE_CRASH_RING
+        // The application would rather be running again than wait for a USB
+        // host: save the crash into flash for later, and restart it
+        const struct crashdump_block *block = crashdump_get_block();
+        if (block && crashdump_resume_vector_ok(block->resume_vector)) {
+            // flash programming is mostly waiting for the flash, but the
+            // zero page scan isn't
+            if (!running_on_fpga())
+                _usb_clock_setup();
+            // watchdog_reboot's state lives in USB DPRAM
+            unreset_block_wait_noinline(RESETS_RESET_USBCTRL_BITS);
+            hw_clear_bits(&xip_ctrl_hw->ctrl, XIP_CTRL_EN_BITS);
+            crash_ring_save_thunk(block);
+        }
+#endif
+    }
     // note this never returns (and is marked as such)
     _usb_boot(0, 0);
 }
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "runtime.h"
+#include "bootrom_crc32.h"
+#include "crash_ring.h"
+
+const uint8_t *crash_ring_slot_base(uint slot) {
+    return (const uint8_t *) (XIP_NOCACHE_NOALLOC_BASE + CRASH_RING_FLASH_OFFSET + slot * CRASH_RING_SLOT_SIZE);
+}
+
+uint32_t crash_ring_header_crc(const struct crash_ring_header *header) {
+    return crc32_small((const uint8_t *) &header->seq,
+                       sizeof(*header) - offsetof(struct crash_ring_header, seq), 0xffffffff);
+}
+
+// Slots whose data_crc has been checked, and which of those matched. The ring
+// doesn't change in USB mode, and a check is ~0.4 s of crc32_small
+static uint16_t crash_ring_checked, crash_ring_data_ok;
+
+static bool crash_ring_check_data(uint slot, const struct crash_ring_header *header) {
+    static const uint8_t zero_page[CRASH_RING_PAGE_SIZE];
+    const uint8_t *data = crash_ring_slot_base(slot) + CRASH_RING_DATA_OFFSET;
+    uint32_t crc = 0xffffffff;
+    for (uint page = 0; page < CRASH_RING_PAGES; page++) {
+        // zero pages were never programmed, so read as erased
+        bool zero = header->zero_pages[page / 32] & (1u << (page % 32));
+        crc = crc32_small(zero ? zero_page : data + page * CRASH_RING_PAGE_SIZE, CRASH_RING_PAGE_SIZE, crc);
+    }
+    return crc == header->data_crc;
+}
+
+const struct crash_ring_header *crash_ring_slot_header(uint slot) {
+    const struct crash_ring_header *header = (const struct crash_ring_header *) crash_ring_slot_base(slot);
+    if (header->magic != CRASH_RING_MAGIC || header->data_size != CRASH_RING_DATA_SIZE ||
+        header->header_crc != crash_ring_header_crc(header)) {
+        return NULL;
+    }
+    return header;
+}
+
+const struct crash_ring_header *crash_ring_slot(uint slot) {
+    const struct crash_ring_header *header = crash_ring_slot_header(slot);
+    if (!header) return NULL;
+    if (!(crash_ring_checked & (1u << slot))) {
+        crash_ring_checked |= 1u << slot;
+        if (crash_ring_check_data(slot, header)) crash_ring_data_ok |= 1u << slot;
+    }
+    return crash_ring_data_ok & (1u << slot) ? header : NULL;
+}
+
+void crash_ring_read(uint slot, uint32_t file_sector, uint8_t *buf) {
+    const struct crash_ring_header *header = crash_ring_slot(slot);
+    if (!header) return;
+    if (!file_sector) {
+        memcpy(buf, header, sizeof(*header));
+        return;
+    }
+    uint page = (file_sector - 1) * (CRASH_RING_FILE_HEADER_SIZE / CRASH_RING_PAGE_SIZE);
+    for (uint i = 0; i < CRASH_RING_FILE_HEADER_SIZE / CRASH_RING_PAGE_SIZE && page < CRASH_RING_PAGES; i++, page++) {
+        // zero pages were never programmed, and buf is already zeroed
+        if (!(header->zero_pages[page / 32] & (1u << (page % 32)))) {
+            memcpy(buf + i * CRASH_RING_PAGE_SIZE,
+                   crash_ring_slot_base(slot) + CRASH_RING_DATA_OFFSET + page * CRASH_RING_PAGE_SIZE,
+                   CRASH_RING_PAGE_SIZE);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRASH_RING_H
+#define _CRASH_RING_H
+
+#include "pico/types.h"
+#include "hardware/regs/addressmap.h"
+#include "crashdump.h"
+
+// A ring of CRASH_RING_SLOTS crash snapshots in flash, starting at
+// CRASH_RING_FLASH_OFFSET. Each slot is a header page followed (at
+// CRASH_RING_DATA_OFFSET) by an image of SRAM, which also holds the
+// application's capture block. The header is programmed last, so a slot only
+// becomes valid once it is complete.
+
+#ifndef CRASH_RING_FLASH_OFFSET
+#define CRASH_RING_FLASH_OFFSET (1u << 20)
+#endif
+#ifndef CRASH_RING_SLOTS
+#define CRASH_RING_SLOTS 2
+#endif
+
+#define CRASH_RING_MAGIC 0x474e4952 // "RING"
+#define CRASH_RING_BLOCK_SIZE (1u << 16) // erased with the 64K block erase
+#define CRASH_RING_PAGE_SIZE 256u
+#define CRASH_RING_DATA_SIZE (SRAM_END - SRAM_BASE)
+#define CRASH_RING_PAGES (CRASH_RING_DATA_SIZE / CRASH_RING_PAGE_SIZE)
+#define CRASH_RING_DATA_OFFSET 4096u
+#define CRASH_RING_SLOT_SIZE \
+    ((CRASH_RING_DATA_OFFSET + CRASH_RING_DATA_SIZE + CRASH_RING_BLOCK_SIZE - 1) & ~(CRASH_RING_BLOCK_SIZE - 1))
+
+static_assert(!(CRASH_RING_FLASH_OFFSET & (CRASH_RING_BLOCK_SIZE - 1)), "");
+static_assert(CRASH_RING_FLASH_OFFSET + CRASH_RING_SLOTS * CRASH_RING_SLOT_SIZE <= (16u << 20), "");
+static_assert(CRASH_RING_SLOTS >= 1 && CRASH_RING_SLOTS <= 9, "file names have one digit");
+static_assert(!(CRASH_RING_PAGES % 32), "");
+
+struct crash_ring_header {
+    uint32_t magic;
+    // crc32_small of the rest of the header, from seq on
+    uint32_t header_crc;
+    // the newest slot has the highest
+    uint32_t seq;
+    // CRC-32 (as crc32_small, seed 0xffffffff) of the SRAM image, zero pages
+    // included; checked before the slot is served
+    uint32_t data_crc;
+    uint32_t data_size;
+    // scratch[CRASHDUMP_SCRATCH_BLOCK] at the crash, i.e. where in the image
+    // the capture block is
+    uint32_t block_addr;
+    // set bits are pages which were all zeroes, and were not programmed
+    uint32_t zero_pages[CRASH_RING_PAGES / 32];
+};
+static_assert(sizeof(struct crash_ring_header) <= CRASH_RING_PAGE_SIZE, "");
+
+// What CRASH00n.BIN (slot n - 1) looks like: the header, padded to a sector, then SRAM
+#define CRASH_RING_FILE_HEADER_SIZE 512u
+#define CRASH_RING_FILE_SIZE (CRASH_RING_FILE_HEADER_SIZE + CRASH_RING_DATA_SIZE)
+
+// Save SRAM (including the capture block) into the oldest (or an invalid)
+// slot, then go back to the application (crashdump_resume). Runs on a
+// stack in XIP SRAM, so the XIP cache must be off already.
+void __attribute__((noreturn)) crash_ring_save_thunk(const struct crashdump_block *block);
+
+// Where slot's header is, read through XIP (crash_ring.c)
+const uint8_t *crash_ring_slot_base(uint slot);
+uint32_t crash_ring_header_crc(const struct crash_ring_header *header);
+
+// The header of a slot with a valid header (read through XIP), or NULL
+const struct crash_ring_header *crash_ring_slot_header(uint slot);
+
+// As crash_ring_slot_header, but also NULL if the SRAM image doesn't match
+// data_crc (checked on the first call for each slot)
+const struct crash_ring_header *crash_ring_slot(uint slot);
+
+// One sector of CRASH00n.BIN; buf must be zeroed
+void crash_ring_read(uint slot, uint32_t file_sector, uint8_t *buf);
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "runtime.h"
+#include "crash_ring.h"
+#include "resets.h"
+#include "hardware/structs/dma.h"
+#include "hardware/structs/ioqspi.h"
+
+#define CRASH_RING_DMA_CHANNEL 0
+#define CRASH_RING_BLOCK_ERASE_CMD 0xd8
+
+#define ROM_TABLE_CODE(c1, c2) ((c1) | ((c2) << 8))
+typedef void *(*rom_table_lookup_fn)(const uint16_t *table, uint32_t code);
+
+// This image runs from flash, so it can't use its own flash driver to write
+// flash: the ROM's routines do the work, called from code copied into XIP
+// SRAM, and boot2 (also copied) sets XIP up again afterwards
+struct crash_ring_write {
+    void (*connect_internal_flash)(void);
+    void (*flash_exit_xip)(void);
+    void (*flash_range_erase)(uint32_t addr, size_t count, uint32_t block_size, uint8_t block_cmd);
+    void (*flash_range_program)(uint32_t addr, const uint8_t *data, size_t count);
+    uint32_t flash_offset;
+};
+
+// All in XIP SRAM; only used on the way back to the application, never in USB
+// mode, so they can share it with the UF2 bitmaps
+static struct crash_ring_write crash_ring_write __attribute__((section(".xip_ram_bss.crash_ring")));
+static uint32_t crash_ring_header_page[CRASH_RING_PAGE_SIZE / 4] __attribute__((section(".xip_ram_bss.crash_ring")));
+static uint32_t crash_ring_boot2[256 / 4] __attribute__((section(".xip_ram_bss.crash_ring")));
+static uint32_t crash_ring_sniff_sink __attribute__((section(".xip_ram_bss.crash_ring")));
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Warray-bounds"
+static void *crash_ring_rom_func(uint32_t code) {
+    rom_table_lookup_fn lookup = (rom_table_lookup_fn) (uintptr_t) *(const uint16_t *) 0x18;
+    return lookup((const uint16_t *) (uintptr_t) *(const uint16_t *) 0x14, code);
+}
+#pragma GCC diagnostic pop
+
+// CRC-32 of SRAM by the DMA sniffer, the same as crc32_small would give but
+// without taking ~70 cycles a byte. Byte transfers, so that the sniffer sees
+// the bytes in memory order.
+static uint32_t crash_ring_data_crc() {
+    unreset_block_wait_noinline(RESETS_RESET_DMA_BITS);
+    dma_hw->sniff_data = 0xffffffff;
+    dma_hw->sniff_ctrl = DMA_SNIFF_CTRL_EN_BITS | (CRASH_RING_DMA_CHANNEL << DMA_SNIFF_CTRL_DMACH_LSB) |
+                         (DMA_SNIFF_CTRL_CALC_VALUE_CRC32 << DMA_SNIFF_CTRL_CALC_LSB);
+    dma_channel_hw_t *c = &dma_hw->ch[CRASH_RING_DMA_CHANNEL];
+    c->read_addr = SRAM_BASE;
+    c->write_addr = (uintptr_t) &crash_ring_sniff_sink;
+    c->transfer_count = CRASH_RING_DATA_SIZE;
+    // chaining to itself means no chaining
+    c->ctrl_trig = DMA_CH0_CTRL_TRIG_SNIFF_EN_BITS | DMA_CH0_CTRL_TRIG_INCR_READ_BITS |
+                   (DMA_CH0_CTRL_TRIG_TREQ_SEL_VALUE_PERMANENT << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB) |
+                   (CRASH_RING_DMA_CHANNEL << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB) | DMA_CH0_CTRL_TRIG_EN_BITS;
+    while (c->ctrl_trig & DMA_CH0_CTRL_TRIG_BUSY_BITS);
+    return dma_hw->sniff_data;
+}
+
+// Copied to XIP SRAM by crash_ring_save, as flash can't be read between
+// flash_exit_xip and boot2. Must not call anything in flash.
+static void __noinline __attribute__((section(".xip_ram_text.crash_ring_program"))) crash_ring_program() {
+    const struct crash_ring_write *w = &crash_ring_write;
+    const struct crash_ring_header *header = (const struct crash_ring_header *) crash_ring_header_page;
+    w->connect_internal_flash();
+    w->flash_exit_xip();
+    w->flash_range_erase(w->flash_offset, CRASH_RING_SLOT_SIZE, CRASH_RING_BLOCK_SIZE, CRASH_RING_BLOCK_ERASE_CMD);
+    for (uint page = 0; page < CRASH_RING_PAGES; page++) {
+        if (!(header->zero_pages[page / 32] & (1u << (page % 32)))) {
+            w->flash_range_program(w->flash_offset + CRASH_RING_DATA_OFFSET + page * CRASH_RING_PAGE_SIZE,
+                                   (const uint8_t *) (SRAM_BASE + page * CRASH_RING_PAGE_SIZE), CRASH_RING_PAGE_SIZE);
+        }
+    }
+    // last, so that an interrupted save leaves an invalid slot rather than a bad one
+    w->flash_range_program(w->flash_offset, (const uint8_t *) header, CRASH_RING_PAGE_SIZE);
+    // flash_exit_xip leaves chip select forced
+    hw_clear_bits(&ioqspi_hw->io[1].ctrl, IO_QSPI_GPIO_QSPI_SS_CTRL_OUTOVER_BITS);
+    ((void (*)(void)) ((uintptr_t) crash_ring_boot2 + 1))();
+}
+
+// Called by crash_ring_save_thunk, i.e. on a stack in XIP SRAM
+void __attribute__((noreturn)) crash_ring_save(const struct crashdump_block *block) {
+    // Oldest (or invalid, which count as older still) slot, numbering from
+    // one past the newest. Only the headers are checked: data_crc would take
+    // a while, and a slot that fails it is just overwritten in its turn
+    uint slot = 0;
+    uint32_t oldest = 0xffffffff, seq = 0;
+    for (uint i = 0; i < CRASH_RING_SLOTS; i++) {
+        const struct crash_ring_header *h = crash_ring_slot_header(i);
+        uint32_t key = h ? h->seq + 1 : 0;
+        if (key < oldest) {
+            oldest = key;
+            slot = i;
+        }
+        if (key > seq) seq = key;
+    }
+
+    struct crash_ring_header *header = (struct crash_ring_header *) crash_ring_header_page;
+    memset0(crash_ring_header_page, sizeof(crash_ring_header_page));
+    header->magic = CRASH_RING_MAGIC;
+    header->seq = seq;
+    header->data_size = CRASH_RING_DATA_SIZE;
+    header->block_addr = (uintptr_t) block;
+    // Mostly unused SRAM is mostly zeroes, which we don't program at all
+    const uint32_t *p = (const uint32_t *) SRAM_BASE;
+    for (uint page = 0; page < CRASH_RING_PAGES; page++) {
+        uint32_t any = 0;
+        for (uint i = 0; i < CRASH_RING_PAGE_SIZE / 4; i++) any |= *p++;
+        if (!any) header->zero_pages[page / 32] |= 1u << (page % 32);
+    }
+    header->data_crc = crash_ring_data_crc();
+    header->header_crc = crash_ring_header_crc(header);
+
+    crash_ring_write.connect_internal_flash = crash_ring_rom_func(ROM_TABLE_CODE('I', 'F'));
+    crash_ring_write.flash_exit_xip = crash_ring_rom_func(ROM_TABLE_CODE('E', 'X'));
+    crash_ring_write.flash_range_erase = crash_ring_rom_func(ROM_TABLE_CODE('R', 'E'));
+    crash_ring_write.flash_range_program = crash_ring_rom_func(ROM_TABLE_CODE('R', 'P'));
+    crash_ring_write.flash_offset = CRASH_RING_FLASH_OFFSET + slot * CRASH_RING_SLOT_SIZE;
+    memcpy(crash_ring_boot2, (const void *) XIP_NOCACHE_NOALLOC_BASE, sizeof(crash_ring_boot2));
+    extern uint8_t __xip_ram_text_start[], __xip_ram_text_end[], __xip_ram_text_source[];
+    memcpy(__xip_ram_text_start, __xip_ram_text_source, __xip_ram_text_end - __xip_ram_text_start);
+    crash_ring_program();
+
+    crashdump_resume(1);
+    while (true) __wfi();
+}
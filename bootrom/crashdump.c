@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <sys/param.h>
+#include "runtime.h"
+#include "crashdump.h"
+#include "usb_boot_device.h"
+#include "hardware/structs/watchdog.h"
+#include "live_export.h"
+#ifdef USE_CRASHDUMP_REGIONS
+#include "xip_arena.h"
+#endif
+
+const struct crashdump_block *crashdump_get_block() {
+#ifdef USE_LIVE_EXPORT
+    // not a crash, but the application is there (live_export.h)
+    return &live_export_block;
+#endif
+    uint32_t magic = watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC];
+    // the block is still there while going back to the application
+    if (magic != CRASHDUMP_MAGIC && magic != CRASHDUMP_RESUME_MAGIC) return NULL;
+    uint32_t addr = watchdog_hw->scratch[CRASHDUMP_SCRATCH_BLOCK];
+    if ((addr & 3u) || addr < SRAM_BASE || addr + sizeof(struct crashdump_block) > SRAM_END) return NULL;
+    const struct crashdump_block *block = (const struct crashdump_block *) addr;
+    if (block->magic != CRASHDUMP_BLOCK_MAGIC || block->size < CRASHDUMP_BLOCK_MIN_SIZE) return NULL;
+    return block;
+}
+
+// A vector table in flash, with a plausible initial SP and reset handler (as
+// crashdump_block is not initialized, resume_vector may be garbage)
+bool crashdump_resume_vector_ok(uint32_t vtor) {
+    if ((vtor & 0xffu) || vtor < XIP_BASE || vtor >= XIP_NOALLOC_BASE) return false;
+    // around the cache, which is off (or the application's) in USB mode
+    const uint32_t *vectors = (const uint32_t *) (vtor - XIP_BASE + XIP_NOCACHE_NOALLOC_BASE);
+    return vectors[0] > SRAM_BASE && vectors[0] <= SRAM_END &&
+           (vectors[1] & 1u) && vectors[1] >= XIP_BASE && vectors[1] < XIP_NOALLOC_BASE;
+}
+
+bool crashdump_resume(uint32_t delay_ms) {
+    // only after a crash, and only once
+    if (watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] != CRASHDUMP_MAGIC) return false;
+    const struct crashdump_block *block = crashdump_get_block();
+    // only through _start_resume: a standard boot would come back into this
+    // image, which would fill SRAM over the crash
+    if (!block || !crashdump_resume_vector_ok(block->resume_vector)) return false;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_RESUME_MAGIC;
+    safe_reboot(0, 0, delay_ms);
+    return true;
+}
+
+#ifdef USE_CRASH_UF2
+void crashdump_replay(uint32_t block_addr) {
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_MAGIC;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_BLOCK] = block_addr;
+    // it was written back as it was, so USE_CRASH_RING would restart it
+    struct crashdump_block *block = (struct crashdump_block *) crashdump_get_block();
+    if (block) block->resume_vector = 0;
+}
+#endif
+
+#ifdef USE_CRASHDUMP_REGIONS
+const struct crashdump_region *crashdump_get_regions(const struct crashdump_block *block, uint32_t *count) {
+    *count = 0;
+    if (!block || block->size < CRASHDUMP_BLOCK_TEXT_OFFSET) return NULL;
+    uint32_t addr = block->regions, size = block->regions_size;
+    if ((addr & 3u) || addr < XIP_BASE || addr >= XIP_NOALLOC_BASE || size > XIP_NOALLOC_BASE - addr ||
+        size % sizeof(struct crashdump_region)) {
+        return NULL;
+    }
+    *count = MIN(size / sizeof(struct crashdump_region), CRASHDUMP_MAX_REGIONS);
+    // the XIP cache is off (its SRAM is our workspace), so read around it
+    return (const struct crashdump_region *) (addr - XIP_BASE + XIP_NOCACHE_NOALLOC_BASE);
+}
+
+void crashdump_regions_init() {
+    struct crashdump_sensitive *sensitive = &xip_arena->crashdump_sensitive;
+    sensitive->count = 0;
+    uint32_t count;
+    const struct crashdump_region *regions = crashdump_get_regions(crashdump_get_block(), &count);
+    for (uint i = 0; i < count; i++) {
+        if (regions[i].flags & CRASHDUMP_REGION_SENSITIVE) {
+            uint32_t addr = regions[i].addr, size = regions[i].size;
+            sensitive->range[sensitive->count].start = addr;
+            sensitive->range[sensitive->count].end = size > 0xffffffffu - addr ? 0xffffffffu : addr + size;
+            sensitive->count++;
+        }
+    }
+}
+
+void crashdump_redact(uint8_t *buf, uint32_t addr, uint32_t len) {
+    const struct crashdump_sensitive *sensitive = &xip_arena->crashdump_sensitive;
+    for (uint i = 0; i < sensitive->count; i++) {
+        uint32_t from = MAX(sensitive->range[i].start, addr), to = MIN(sensitive->range[i].end, addr + len);
+        if (from < to) memset0(buf + (from - addr), to - from);
+    }
+}
+#endif
+
+#ifdef USE_AUTO_RESUME
+static bool crashdump_enumeration_timeout_armed;
+
+void crashdump_arm_enumeration_timeout() {
+    if (AUTO_RESUME_ENUMERATION_TIMEOUT_MS && crashdump_resume(AUTO_RESUME_ENUMERATION_TIMEOUT_MS)) {
+        crashdump_enumeration_timeout_armed = true;
+    }
+}
+
+void crashdump_on_configure() {
+    if (crashdump_enumeration_timeout_armed) {
+        crashdump_enumeration_timeout_armed = false;
+        watchdog_reboot_cancel();
+        watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_MAGIC;
+    }
+}
+#endif
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRASHDUMP_H
+#define _CRASHDUMP_H
+
+// Handshake between a crashing application and the crash dump image, via the
+// watchdog scratch registers (which survive the watchdog reset). Included from
+// assembler, so the layout is given as offsets too.
+//
+// scratch[0] and scratch[1] are used by reset_usb_boot, and scratch[4..7] by
+// the bootrom's own watchdog boot, so we have scratch[2] and scratch[3].
+
+// scratch[CRASHDUMP_SCRATCH_MAGIC] == CRASHDUMP_MAGIC means SRAM holds the
+// state of a crashed application: don't touch it, and skip any setup the
+// application will already have done
+#define CRASHDUMP_SCRATCH_MAGIC 2
+#define CRASHDUMP_MAGIC 0xc4a5d0e7
+
+// scratch[CRASHDUMP_SCRATCH_MAGIC] == CRASHDUMP_RESUME_MAGIC means we are done
+// with the crash (see crashdump_resume): just start the application through
+// crashdump_block.resume_vector
+#define CRASHDUMP_RESUME_MAGIC 0x7e5a11ed
+
+// scratch[CRASHDUMP_SCRATCH_BLOCK] points at the application's capture block
+// (struct crashdump_block), which lives in its .uninitialized_data
+#define CRASHDUMP_SCRATCH_BLOCK 3
+
+#define CRASHDUMP_BLOCK_MAGIC 0x504d4443 // "CDMP"
+#define CRASHDUMP_NUM_CORES 2
+
+// crashdump_block.resume_vector, if it is the address of a plausible vector
+// table in flash, asks the crash dump image (built with USE_CRASH_RING) to save
+// the crash into its flash ring and restart the application through that
+// vector table, rather than waiting in USB dump mode
+
+// struct crashdump_block
+#define CRASHDUMP_BLOCK_MAGIC_OFFSET        0x00
+#define CRASHDUMP_BLOCK_SIZE_OFFSET         0x04
+#define CRASHDUMP_BLOCK_CRASHED_CORE_OFFSET 0x08
+#define CRASHDUMP_BLOCK_RESUME_VECTOR_OFFSET 0x0c
+#define CRASHDUMP_BLOCK_CORE_OFFSET         0x10
+#define CRASHDUMP_BLOCK_REGIONS_OFFSET (CRASHDUMP_BLOCK_CORE_OFFSET + CRASHDUMP_NUM_CORES * CRASHDUMP_REGS_SIZE)
+#define CRASHDUMP_BLOCK_TEXT_OFFSET (CRASHDUMP_BLOCK_REGIONS_OFFSET + 8)
+#define CRASHDUMP_BLOCK_SIZE (CRASHDUMP_BLOCK_TEXT_OFFSET + 8)
+// older capture libraries' blocks end at the regions
+#define CRASHDUMP_BLOCK_MIN_SIZE CRASHDUMP_BLOCK_REGIONS_OFFSET
+
+// struct crashdump_regs
+#define CRASHDUMP_REGS_SIZE_SHIFT   7
+#define CRASHDUMP_REGS_SIZE         (1 << CRASHDUMP_REGS_SIZE_SHIFT)
+#define CRASHDUMP_REGS_R0_OFFSET    0x00
+#define CRASHDUMP_REGS_R4_OFFSET    0x10
+#define CRASHDUMP_REGS_R8_OFFSET    0x20
+#define CRASHDUMP_REGS_R12_OFFSET   0x30
+#define CRASHDUMP_REGS_SP_OFFSET    0x34
+#define CRASHDUMP_REGS_LR_OFFSET    0x38
+#define CRASHDUMP_REGS_PC_OFFSET    0x3c
+#define CRASHDUMP_REGS_XPSR_OFFSET  0x40
+#define CRASHDUMP_REGS_MSP_OFFSET   0x44
+#define CRASHDUMP_REGS_PSP_OFFSET   0x48
+#define CRASHDUMP_REGS_EXC_RETURN_OFFSET 0x4c
+#define CRASHDUMP_REGS_STATE_OFFSET 0x50
+#define CRASHDUMP_REGS_STACK_TOP_OFFSET 0x54
+
+// crashdump_regs.state
+#define CRASHDUMP_STATE_NONE    0   // not captured
+#define CRASHDUMP_STATE_FAULTED 1   // this core took the fault
+#define CRASHDUMP_STATE_FROZEN  2   // stopped by the other core's fault
+
+// The application's table of interesting memory, from the crashdump_regions
+// section (see CRASHDUMP_REGION in crash_capture.h); at most
+// CRASHDUMP_MAX_REGIONS are used
+#define CRASHDUMP_MAX_REGIONS 16
+// crashdump_region.flags
+#define CRASHDUMP_REGION_SENSITIVE 0x01 // never shown: blanked in CRASHDMP.XXD and MINIDUMP.BIN
+#define CRASHDUMP_REGION_SKIP      0x02 // not worth the transfer: left out of MINIDUMP.BIN
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+
+struct crashdump_regs {
+    // r0-r12, sp, lr, pc of the code that was running when the fault was taken
+    uint32_t r[16];
+    uint32_t xpsr;
+    // stack pointers as seen by the fault handler
+    uint32_t msp;
+    uint32_t psp;
+    uint32_t exc_return;
+    uint32_t state;
+    // the top of the core's main stack, from the application's linker script
+    // (older capture libraries leave this uninitialized)
+    uint32_t stack_top;
+    uint32_t _pad[10];
+};
+
+struct crashdump_block {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crashed_core;
+    // Set by the application (not the capture stub), see crashdump_persist()
+    uint32_t resume_vector;
+    struct crashdump_regs core[CRASHDUMP_NUM_CORES];
+    // Set by the capture library: the application's crashdump_regions section
+    uint32_t regions;
+    uint32_t regions_size;
+    // Set by the capture library: the application's code in flash, from its
+    // linker script (zero if it didn't say)
+    uint32_t text_start;
+    uint32_t text_end;
+};
+
+struct crashdump_region {
+    uint32_t addr;
+    uint32_t size;
+    // lower goes first in MINIDUMP.BIN
+    uint8_t priority;
+    uint8_t flags;
+    uint16_t _reserved;
+    // not NUL terminated if it is all used
+    char name[12];
+};
+
+static_assert(sizeof(struct crashdump_regs) == CRASHDUMP_REGS_SIZE, "");
+static_assert(offsetof(struct crashdump_regs, xpsr) == CRASHDUMP_REGS_XPSR_OFFSET, "");
+static_assert(offsetof(struct crashdump_regs, exc_return) == CRASHDUMP_REGS_EXC_RETURN_OFFSET, "");
+static_assert(offsetof(struct crashdump_regs, state) == CRASHDUMP_REGS_STATE_OFFSET, "");
+static_assert(offsetof(struct crashdump_regs, stack_top) == CRASHDUMP_REGS_STACK_TOP_OFFSET, "");
+static_assert(offsetof(struct crashdump_block, resume_vector) == CRASHDUMP_BLOCK_RESUME_VECTOR_OFFSET, "");
+static_assert(offsetof(struct crashdump_block, core) == CRASHDUMP_BLOCK_CORE_OFFSET, "");
+static_assert(offsetof(struct crashdump_block, regions) == CRASHDUMP_BLOCK_REGIONS_OFFSET, "");
+static_assert(offsetof(struct crashdump_block, text_start) == CRASHDUMP_BLOCK_TEXT_OFFSET, "");
+static_assert(sizeof(struct crashdump_region) == 24, "");
+static_assert(sizeof(struct crashdump_block) == CRASHDUMP_BLOCK_SIZE, "");
+
+// The rest is the crash dump image's side (crashdump.c)
+
+// The application's capture block, if we were entered from a crash and it
+// looks sane
+const struct crashdump_block *crashdump_get_block(void);
+bool crashdump_resume_vector_ok(uint32_t vtor);
+
+// Go back to the application after delay_ms, through its resume_vector; false
+// (staying in dump mode) unless we were entered from a crash and it set one
+bool crashdump_resume(uint32_t delay_ms);
+
+#ifdef USE_CRASH_UF2
+// SRAM has just been loaded back from CRASHDMP.UF2: make the next boot come
+// up in dump mode on it, with the capture block at block_addr (if any), and
+// stay there rather than going back to the application
+void crashdump_replay(uint32_t block_addr);
+#endif
+
+#ifdef USE_CRASHDUMP_REGIONS
+// The application's region table (read through XIP, which must not be busy),
+// and how many entries it has; NULL if it has none
+const struct crashdump_region *crashdump_get_regions(const struct crashdump_block *block, uint32_t *count);
+
+// The sensitive regions, as [start, end), collected by crashdump_regions_init
+// on entry into the XIP arena, so that they can be blanked without going to
+// flash
+struct crashdump_sensitive {
+    uint32_t count;
+    struct {
+        uint32_t start;
+        uint32_t end;
+    } range[CRASHDUMP_MAX_REGIONS];
+};
+
+void crashdump_regions_init(void);
+
+// Zero whatever of the sensitive regions is in the len bytes read from addr
+void crashdump_redact(uint8_t *buf, uint32_t addr, uint32_t len);
+#endif
+
+#ifdef USE_AUTO_RESUME
+// After a crash, go back to the application after this long without a USB
+// host configuring us (0 to wait forever). Note the watchdog counter is 24
+// bits of microseconds.
+#ifndef AUTO_RESUME_ENUMERATION_TIMEOUT_MS
+#define AUTO_RESUME_ENUMERATION_TIMEOUT_MS 5000
+#endif
+static_assert(AUTO_RESUME_ENUMERATION_TIMEOUT_MS * 1000ull <= 0xffffff, "");
+// After an eject, or the host having read the whole dump, give it this long
+// to finish up
+#ifndef AUTO_RESUME_DELAY_MS
+#define AUTO_RESUME_DELAY_MS 100
+#endif
+
+void crashdump_arm_enumeration_timeout(void);
+void crashdump_on_configure(void);
+#endif
+#endif
+
+#endif
@@ -0,0 +1,390 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <sys/param.h>
+#include "gdb_stub.h"
+#include "crashdump.h"
+#include "usb_boot_device.h"
+#include "xip_arena.h"
+
+#define gdb (&xip_arena->gdb_stub)
+
+struct usb_endpoint gdb_stub_endpoints[2];
+#define gdb_out gdb_stub_endpoints[0]
+#define gdb_in gdb_stub_endpoints[1]
+
+struct async_task_queue gdb_stub_queue;
+
+static struct usb_transfer _gdb_cmd_transfer;
+static struct usb_transfer _gdb_reply_transfer;
+
+// gdb_stub.state
+enum {
+    GDB_IDLE,
+    GDB_DATA,
+    GDB_CHECK_HI,
+    GDB_CHECK_LO,
+};
+
+// what m can read, less XIP SRAM (which is our workspace) and the
+// peripherals; the ROM as far as PICOBOOT reads it
+static const char _memory_map[] =
+        "<memory-map>"
+        "<memory type=\"rom\" start=\"0x0\" length=\"0x2000\"/>"
+        "<memory type=\"rom\" start=\"0x10000000\" length=\"0x1000000\"/>"
+        "<memory type=\"ram\" start=\"0x20000000\" length=\"0x42000\"/>"
+        "</memory-map>";
+
+// the capture block's registers, in its order: r0-r15 then xpsr, so gdb
+// needs no ELF to know it is talking to an M-profile core
+static const char _target_xml[] =
+        "<target><architecture>arm</architecture><feature name=\"org.gnu.gdb.arm.m-profile\">"
+        "<reg name=\"r0\" bitsize=\"32\"/><reg name=\"r1\" bitsize=\"32\"/><reg name=\"r2\" bitsize=\"32\"/>"
+        "<reg name=\"r3\" bitsize=\"32\"/><reg name=\"r4\" bitsize=\"32\"/><reg name=\"r5\" bitsize=\"32\"/>"
+        "<reg name=\"r6\" bitsize=\"32\"/><reg name=\"r7\" bitsize=\"32\"/><reg name=\"r8\" bitsize=\"32\"/>"
+        "<reg name=\"r9\" bitsize=\"32\"/><reg name=\"r10\" bitsize=\"32\"/><reg name=\"r11\" bitsize=\"32\"/>"
+        "<reg name=\"r12\" bitsize=\"32\"/><reg name=\"sp\" bitsize=\"32\" type=\"data_ptr\"/>"
+        "<reg name=\"lr\" bitsize=\"32\"/><reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\"/>"
+        "<reg name=\"xpsr\" bitsize=\"32\"/></feature></target>";
+static_assert(offsetof(struct crashdump_regs, xpsr) == 16 * 4, "");
+
+static const char _supported[] = "PacketSize=208;qXfer:memory-map:read+;qXfer:features:read+;QStartNoAckMode+";
+static_assert(GDB_STUB_READ_MAX * 2 + 8 <= 0x208, "");
+
+// crashdump_regs.state
+static const char *const _state_names[] = {"not captured", "faulted", "frozen"};
+
+// -------------------------------------------------------------------------------------------------------------
+// Replies
+
+__rom_function_static_impl(void, _gdb_stub_reply_packet)(struct usb_endpoint *ep);
+
+static const struct usb_transfer_type _gdb_reply_transfer_type = {
+        .on_packet = __rom_function_ref(_gdb_stub_reply_packet),
+        .initial_packet_count = 1,
+};
+
+static uint32_t _body_chars() {
+    return gdb->body_hex ? gdb->body_len * 2 : gdb->body_len;
+}
+
+static char _reply_char() {
+    uint32_t i = gdb->reply_pos++;
+    if (gdb->ack) {
+        if (!i) return gdb->ack;
+        i--;
+    }
+    if (!i--) return '$';
+    char c;
+    if (i < gdb->head_len) {
+        c = gdb->head[i];
+    } else if ((i -= gdb->head_len) < _body_chars()) {
+        if (!gdb->body_hex) {
+            c = (char) gdb->body[i];
+        } else if (!gdb->body) {
+            // unavailable, for registers
+            c = 'x';
+        } else {
+            hex((uint8_t *) &c, gdb->body[i / 2] >> (i & 1u ? 0 : 4), 1);
+        }
+    } else {
+        i -= _body_chars();
+        if (!i) return '#';
+        hex((uint8_t *) &c, gdb->reply_sum >> (i == 1 ? 4 : 0), 1);
+        return c;
+    }
+    gdb->reply_sum += (uint8_t) c;
+    return c;
+}
+
+__rom_function_static_impl(void, _gdb_stub_reply_packet)(struct usb_endpoint *ep) {
+    struct usb_buffer *buffer = usb_current_in_packet_buffer(ep);
+    uint len = MIN(gdb->reply_len - gdb->reply_pos, 64u);
+    for (uint i = 0; i < len; i++) buffer->data[i] = _reply_char();
+    buffer->data_len = len;
+    usb_packet_done(ep);
+}
+
+static void _tf_reply_sent(__unused struct usb_endpoint *ep, __unused struct usb_transfer *transfer) {
+    // let the host send the next command
+    usb_packet_done(&gdb_out);
+}
+
+static void _reply_start() {
+    gdb->reply_pos = 0;
+    gdb->reply_sum = 0;
+    gdb->reply_len = gdb->ack ? 1 : 0;
+    if (gdb->packet) gdb->reply_len += 4 + gdb->head_len + _body_chars();
+    usb_reset_transfer(&_gdb_reply_transfer, &_gdb_reply_transfer_type, _tf_reply_sent);
+    // one more packet than is full, so that a reply of whole packets ends
+    // with an empty one
+    usb_grow_transfer(&_gdb_reply_transfer, gdb->reply_len / 64);
+    usb_start_transfer(&gdb_in, &_gdb_reply_transfer);
+}
+
+static void _reply(const char *head, uint len) {
+    memcpy(gdb->head, head, len);
+    gdb->head_len = len;
+    _reply_start();
+}
+
+#define _reply_lit(s) _reply(s, sizeof(s) - 1)
+
+static void _reply_body(const void *body, uint32_t len, bool hex) {
+    gdb->body = body;
+    gdb->body_len = len;
+    gdb->body_hex = hex;
+    _reply_start();
+}
+
+static void _reply_stop(uint core) {
+    static const char stop[] = "T05thread:0";
+    memcpy(gdb->head, stop, sizeof(stop) - 1);
+    gdb->head[sizeof(stop) - 1] = (char) ('1' + core);
+    gdb->head[sizeof(stop)] = ';';
+    gdb->head_len = sizeof(stop) + 1;
+    _reply_start();
+}
+
+// -------------------------------------------------------------------------------------------------------------
+// Commands
+
+static uint _unhex(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return 16;
+}
+
+static const char *_parse_hex(const char *p, uint32_t *value) {
+    uint32_t v = 0;
+    for (uint d; (d = _unhex(*p)) < 16; p++) v = (v << 4) | d;
+    *value = v;
+    return p;
+}
+
+// What follows prefix in s, or NULL if s doesn't start with it
+static const char *_after(const char *s, const char *prefix) {
+    while (*prefix) {
+        if (*s++ != *prefix++) return NULL;
+    }
+    return s;
+}
+
+static uint32_t _thread(const char *p) {
+    uint32_t thread;
+    _parse_hex(p, &thread);
+    return thread;
+}
+
+static void _reply_regs(const struct crashdump_block *block, uint first, uint count) {
+    const struct crashdump_regs *regs = block ? &block->core[gdb->core] : NULL;
+    _reply_body(regs && regs->state != CRASHDUMP_STATE_NONE ? (const uint8_t *) &regs->r[first] : NULL, count * 4,
+                true);
+}
+
+// "offset,length" of a qXfer document
+static void _reply_xfer(const char *doc, uint32_t size, const char *p) {
+    uint32_t offset, len;
+    p = _parse_hex(p, &offset);
+    if (*p != ',') return _reply_lit("E01");
+    _parse_hex(p + 1, &len);
+    if (offset >= size) return _reply_lit("l");
+    len = MIN(len, MIN(size - offset, GDB_STUB_READ_MAX * 2));
+    gdb->head[0] = offset + len == size ? 'l' : 'm';
+    gdb->head_len = 1;
+    _reply_body(doc + offset, len, false);
+}
+
+static void _atc_read_done(struct async_task *task) {
+    // from before the host last configured us
+    if (task->token != gdb->token) return;
+    if (task->result) {
+        gdb->body_len = 0;
+        return _reply_lit("E01");
+    }
+#ifdef USE_CRASHDUMP_REGIONS
+    crashdump_redact(gdb->read_buf, task->transfer_addr, GDB_STUB_READ_MAX);
+#endif
+    _reply_start();
+}
+
+// "addr,length": as much as fits in a reply, and in the flash page, which is
+// read whole as PICOBOOT's are
+static void _read(const char *p) {
+    uint32_t addr, len;
+    p = _parse_hex(p, &addr);
+    if (*p != ',') return _reply_lit("E01");
+    _parse_hex(p + 1, &len);
+    bool flash = is_address_flash(addr);
+    uint32_t offset = flash ? addr & FLASH_PAGE_MASK : 0;
+    len = MIN(len, GDB_STUB_READ_MAX - offset);
+    gdb->body = gdb->read_buf + offset;
+    gdb->body_len = len;
+    gdb->body_hex = true;
+    if (!len) return _reply_start();
+    struct async_task task;
+    reset_task(&task);
+    task.token = ++gdb->token;
+    task.type = AT_READ;
+    task.transfer_addr = addr - offset;
+    task.data = gdb->read_buf;
+    task.data_length = flash ? FLASH_PAGE_SIZE : len;
+    queue_task(&gdb_stub_queue, &task, _atc_read_done);
+}
+
+static void _query(const char *cmd) {
+    const char *p;
+    if (_after(cmd, "Supported")) return _reply_body(_supported, sizeof(_supported) - 1, false);
+    if ((p = _after(cmd, "Xfer:memory-map:read::"))) return _reply_xfer(_memory_map, sizeof(_memory_map) - 1, p);
+    if ((p = _after(cmd, "Xfer:features:read:target.xml:"))) {
+        return _reply_xfer(_target_xml, sizeof(_target_xml) - 1, p);
+    }
+    if (_after(cmd, "fThreadInfo")) return _reply_lit("m1,2");
+    if (_after(cmd, "sThreadInfo")) return _reply_lit("l");
+    if (_after(cmd, "Attached")) return _reply_lit("1");
+    const struct crashdump_block *block = crashdump_get_block();
+    if (_after(cmd, "C")) {
+        gdb->head[0] = 'Q';
+        gdb->head[1] = 'C';
+        gdb->head[2] = (char) ('1' + (block ? block->crashed_core & 1u : 0));
+        gdb->head_len = 3;
+        return _reply_start();
+    }
+    if ((p = _after(cmd, "ThreadExtraInfo,"))) {
+        uint32_t thread = _thread(p) - 1;
+        uint32_t state = block && thread < CRASHDUMP_NUM_CORES ? block->core[thread].state : CRASHDUMP_STATE_NONE;
+        const char *name = _state_names[state < count_of(_state_names) ? state : CRASHDUMP_STATE_NONE];
+        uint32_t len = 0;
+        while (name[len]) len++;
+        return _reply_body(name, len, true);
+    }
+    _reply_start();
+}
+
+static void _command() {
+    const char *cmd = gdb->cmd;
+    gdb->packet = true;
+    gdb->head_len = 0;
+    gdb->body = NULL;
+    gdb->body_len = 0;
+    gdb->body_hex = false;
+    const struct crashdump_block *block = crashdump_get_block();
+    uint32_t n;
+    switch (cmd[0]) {
+        case '?':
+        // the target never runs, so has stopped again at once
+        case 'c':
+        case 's':
+            return _reply_stop(block ? block->crashed_core & 1u : 0);
+        case 'g':
+            return _reply_regs(block, 0, 17);
+        case 'p':
+            // xpsr follows pc
+            _parse_hex(cmd + 1, &n);
+            if (n <= 16) return _reply_regs(block, n, 1);
+            return _reply_lit("E01");
+        case 'm':
+            return _read(cmd + 1);
+        case 'H':
+            // 0 and -1 (any and all) leave it as it is
+            n = _thread(cmd + 2) - 1;
+            if (cmd[1] == 'g' && n < CRASHDUMP_NUM_CORES) gdb->core = n;
+            return _reply_lit("OK");
+        case 'T':
+            if (_thread(cmd + 1) - 1 < CRASHDUMP_NUM_CORES) return _reply_lit("OK");
+            return _reply_lit("E01");
+        case 'D':
+        case 'k':
+            return _reply_lit("OK");
+        case 'q':
+            return _query(cmd + 1);
+        case 'Q':
+            if (_after(cmd, "QStartNoAckMode")) {
+                // this reply is still acked
+                gdb->no_ack = true;
+                return _reply_lit("OK");
+            }
+            break;
+    }
+    // not supported
+    _reply_start();
+}
+
+// -------------------------------------------------------------------------------------------------------------
+// Commands in
+
+// True if c started a reply, which the packet it came in is held for
+static bool _gdb_rx(char c) {
+    switch (gdb->state) {
+        case GDB_IDLE:
+            if (c == '$') {
+                gdb->state = GDB_DATA;
+                gdb->cmd_len = 0;
+                gdb->sum = 0;
+            } else if (c == '-' && gdb->reply_len) {
+                _reply_start();
+                return true;
+            }
+            // acks, and ^C (there is nothing to interrupt)
+            return false;
+        case GDB_DATA:
+            if (c == '#') {
+                gdb->state = GDB_CHECK_HI;
+            } else {
+                gdb->sum += (uint8_t) c;
+                if (gdb->cmd_len < GDB_STUB_CMD_MAX - 1) gdb->cmd[gdb->cmd_len++] = c;
+            }
+            return false;
+        case GDB_CHECK_HI:
+            gdb->check = _unhex(c) << 4;
+            gdb->state = GDB_CHECK_LO;
+            return false;
+        default:
+            gdb->check |= _unhex(c);
+            gdb->state = GDB_IDLE;
+            if (gdb->check != gdb->sum && !gdb->no_ack) {
+                gdb->ack = '-';
+                gdb->packet = false;
+                _reply_start();
+                return true;
+            }
+            gdb->ack = gdb->no_ack ? 0 : '+';
+            gdb->cmd[gdb->cmd_len] = 0;
+            _command();
+            return true;
+    }
+}
+
+__rom_function_static_impl(void, _gdb_stub_cmd_packet)(struct usb_endpoint *ep) {
+    struct usb_buffer *buffer = usb_current_out_packet_buffer(ep);
+    // the transfer goes on for as long as the host sends
+    usb_grow_transfer(ep->current_transfer, 1);
+    bool replying = false;
+    // anything after a command in the same packet is dropped
+    for (uint i = 0; i < buffer->data_len && !replying; i++) replying = _gdb_rx((char) buffer->data[i]);
+    if (!replying) usb_packet_done(ep);
+}
+
+static const struct usb_transfer_type _gdb_cmd_transfer_type = {
+        .on_packet = __rom_function_ref(_gdb_stub_cmd_packet),
+        .initial_packet_count = 1,
+};
+
+void gdb_stub_init() {
+    _gdb_cmd_transfer.type = &_gdb_cmd_transfer_type;
+    usb_set_default_transfer(&gdb_out, &_gdb_cmd_transfer);
+}
+
+void gdb_stub_on_configure(__unused bool configured) {
+    // forget everything, along with any read still in flight
+    uint32_t token = gdb->token;
+    memset0(gdb, offsetof(struct gdb_stub, read_buf));
+    gdb->token = token + 1;
+    reset_queue(&gdb_stub_queue);
+    const struct crashdump_block *block = crashdump_get_block();
+    gdb->core = block ? block->crashed_core & 1u : 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _GDB_STUB_H
+#define _GDB_STUB_H
+
+#include "runtime.h"
+#include "async_task.h"
+#include "usb_device.h"
+
+// A GDB remote serial protocol server on the boot device's CDC-ACM interface
+// (usb_boot_device.c), so that `target remote /dev/ttyACM0` fetches just what
+// gdb touches rather than the whole image: memory (m) through the same async
+// task reads as PICOBOOT, so from the frozen SRAM, flash and ROM; and the
+// registers (g, p) of each core, as threads 1 and 2, from the capture block.
+// Nothing can be written, and the target never runs.
+//
+// Each OUT packet that completes a command is held (so the host is NAKed)
+// until the reply has gone; the reply is generated as the IN packets are
+// filled, so no more than one read is buffered. The state lives in the XIP
+// arena (xip_arena.h), and is set up again whenever the device is configured.
+
+// the largest m the host is told to send (PacketSize), and the most one
+// reply carries; a read never crosses a flash page
+#define GDB_STUB_READ_MAX FLASH_PAGE_SIZE
+// what is kept of a command; the rest only goes into the checksum
+#define GDB_STUB_CMD_MAX 48
+
+struct gdb_stub {
+    char cmd[GDB_STUB_CMD_MAX];
+    uint8_t cmd_len;
+    // where the parser is in a packet (gdb_stub.c)
+    uint8_t state;
+    uint8_t sum;
+    uint8_t check;
+    bool no_ack;
+    // the core g and p read
+    uint8_t core;
+    // the async read in progress, or the last
+    uint32_t token;
+    // the reply: an ack, then unless it is just an ack, $, head, body (as it
+    // is or in hex) and the checksum
+    char ack;
+    bool packet;
+    bool body_hex;
+    uint8_t head_len;
+    char head[16];
+    const uint8_t *body;
+    uint32_t body_len;
+    uint32_t reply_len;
+    uint32_t reply_pos;
+    uint8_t reply_sum;
+    uint8_t read_buf[GDB_STUB_READ_MAX];
+};
+
+// The data interface's endpoints (OUT, IN)
+extern struct usb_endpoint gdb_stub_endpoints[2];
+
+extern struct async_task_queue gdb_stub_queue;
+
+// Set up the endpoints' transfers, once
+void gdb_stub_init(void);
+
+void gdb_stub_on_configure(bool configured);
+
+#endif
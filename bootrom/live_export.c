@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The image's USB side as a library for the application (see live_export.h),
+// less what needs the bootrom: what runtime.c, bootrom_rt0.S and
+// program_flash_generic.c would provide, and _usb_boot for core1
+
+#include "hardware/regs/dreq.h"
+#include "hardware/regs/m0plus.h"
+#include "hardware/structs/dma.h"
+#include "hardware/structs/usb.h"
+#include "hardware/resets.h"
+
+#include "live_export.h"
+#include "async_task.h"
+#include "ram_stats.h"
+#include "usb_boot_device.h"
+#include "program_flash_generic.h"
+#include "xip_arena.h"
+#include "git_info.h"
+
+// the capture library's symbols too: the linker makes them up, if the
+// application has any CRASHDUMP_REGIONs
+extern const struct crashdump_region __start_crashdump_regions[] __attribute__((weak));
+extern const struct crashdump_region __stop_crashdump_regions[] __attribute__((weak));
+
+uint32_t live_export_workspace[FLASH_WORKSPACE_SIZE / 4];
+struct crashdump_block live_export_block;
+
+static uint _dma_channel;
+
+void *__memcpy(void *dest, const void *src, uint n) {
+    return __builtin_memcpy(dest, src, n);
+}
+
+void memset0(void *dest, uint n) {
+    __builtin_memset(dest, 0, n);
+}
+
+// as bootrom_rt0.S
+void _noop() {
+}
+
+uint32_t software_git_revision = GIT_REV;
+
+// nothing here programs flash (async_task.c), so there is nothing to abort
+void flash_abort() {
+}
+
+// as runtime.c, but on whichever core calls it (each has its own NVIC)
+void interrupt_enable(uint irq, bool enable) {
+    if (enable) {
+        *(volatile uint32_t *) (PPB_BASE + M0PLUS_NVIC_ICPR_OFFSET) = 1u << irq;
+        *(volatile uint32_t *) (PPB_BASE + M0PLUS_NVIC_ISER_OFFSET) = 1u << irq;
+    } else {
+        *(volatile uint32_t *) (PPB_BASE + M0PLUS_NVIC_ICER_OFFSET) = 1u << irq;
+    }
+}
+
+// the application decides when to reboot (see safe_reboot)
+bool watchdog_rebooting() {
+    return false;
+}
+
+// None of it is ours to measure
+void ram_stats_get(struct ram_stats *stats) {
+    stats->bss_size = RAM_STATS_UNKNOWN;
+    stats->stack_size = RAM_STATS_UNKNOWN;
+    stats->stack_used = RAM_STATS_UNKNOWN;
+    stats->sram_stack_used = RAM_STATS_UNKNOWN;
+    stats->sram_touched = RAM_STATS_UNKNOWN;
+}
+
+// Whole words if it can, at high priority, so the copy is over quickly and the
+// application's own accesses interleave with it as little as possible
+void live_export_copy(void *dest, const void *src, uint32_t len) {
+    bool words = !(((uintptr_t) dest | (uintptr_t) src | len) & 3u);
+    dma_channel_hw_t *c = &dma_hw->ch[_dma_channel];
+    c->read_addr = (uintptr_t) src;
+    c->write_addr = (uintptr_t) dest;
+    c->transfer_count = words ? len / 4 : len;
+    // chaining to itself means no chaining
+    c->ctrl_trig = ((words ? DMA_CH0_CTRL_TRIG_DATA_SIZE_VALUE_SIZE_WORD : DMA_CH0_CTRL_TRIG_DATA_SIZE_VALUE_SIZE_BYTE)
+                    << DMA_CH0_CTRL_TRIG_DATA_SIZE_LSB) |
+                   (DREQ_FORCE << DMA_CH0_CTRL_TRIG_TREQ_SEL_LSB) |
+                   (_dma_channel << DMA_CH0_CTRL_TRIG_CHAIN_TO_LSB) |
+                   DMA_CH0_CTRL_TRIG_INCR_READ_BITS | DMA_CH0_CTRL_TRIG_INCR_WRITE_BITS |
+                   DMA_CH0_CTRL_TRIG_HIGH_PRIORITY_BITS | DMA_CH0_CTRL_TRIG_EN_BITS;
+    while (c->ctrl_trig & DMA_CH0_CTRL_TRIG_BUSY_BITS);
+}
+
+// As _usb_boot, less the clocks (the application's) and the XIP cache (which
+// it runs from)
+void __attribute__((noreturn)) live_export_core1(uint dma_channel) {
+    _dma_channel = dma_channel;
+
+    live_export_block.magic = CRASHDUMP_BLOCK_MAGIC;
+    live_export_block.size = sizeof(live_export_block);
+    live_export_block.regions = (uintptr_t) __start_crashdump_regions;
+    live_export_block.regions_size = (uintptr_t) __stop_crashdump_regions - (uintptr_t) __start_crashdump_regions;
+
+    reset_block(RESETS_RESET_USBCTRL_BITS);
+    unreset_block_wait(RESETS_RESET_USBCTRL_BITS);
+    memset0(usb_dpram, USB_DPRAM_SIZE);
+
+    usb_boot_device_start(0);
+    // on this stack (the application's for core1); the USB interrupt is
+    // taken here too, as usb_device_start enabled it on this core
+    async_task_worker();
+}
@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LIVE_EXPORT_H
+#define _LIVE_EXPORT_H
+
+#include "runtime.h"
+#include "crashdump.h"
+
+// With USE_LIVE_EXPORT, the USB side of the image (MSC and PICOBOOT, with the
+// virtual disk's sector generators) is linked into the application instead,
+// and run on core1 while core0 goes on (see capture/crash_live.h). Memory is
+// then read as it is at the time: each piece the host asks for (a sector of
+// CRASHDMP.XXD or MINIDUMP.BIN, a PICOBOOT read) is DMA-copied in one go into
+// the buffer it is served from, rather than read byte by byte as it is
+// formatted, so that it is at least consistent with itself.
+//
+// Nothing can be written: the application owns its flash and RAM, so UF2
+// blocks are ignored, and PICOBOOT does reads only, of flash through XIP
+// (around the cache). There is no crash, so REGS.TXT is blank, but the
+// application's regions (CRASHDUMP_REGION) are served and redacted as after
+// one.
+
+#ifdef USE_LIVE_EXPORT
+// A block without a crash, for the application's regions
+extern struct crashdump_block live_export_block;
+
+// Start the image on core1, which doesn't return; dma_channel is the
+// application's to give away for good
+void __attribute__((noreturn)) live_export_core1(uint dma_channel);
+
+// Copy len bytes of live memory from src to dest, by DMA
+void live_export_copy(void *dest, const void *src, uint32_t len);
+#else
+// after a crash nothing else is running
+#define live_export_copy(dest, src, len) memcpy(dest, src, len)
+#endif
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <stdarg.h>
+#include <sys/param.h>
+#include "runtime.h"
+#include "hardware/sync.h"
+#include "xip_arena.h"
+
+#define ring (&xip_arena->log)
+
+void log_init() {
+    ring->version = LOG_VERSION;
+    ring->words = LOG_RING_WORDS;
+    ring->head = ring->tail = ring->lost = 0;
+    ring->magic = LOG_MAGIC;
+}
+
+static void _put(uint32_t word) {
+    ring->word[ring->head++ & (LOG_RING_WORDS - 1)] = word;
+}
+
+void log_write(uint32_t header, ...) {
+    // from the worker and from IRQs
+    uint32_t save = save_and_disable_interrupts();
+    if (ring->magic == LOG_MAGIC) {
+        // make room, a whole entry at a time
+        while (ring->head + LOG_ENTRY_WORDS(header) - ring->tail > LOG_RING_WORDS) {
+            ring->tail += LOG_ENTRY_WORDS(ring->word[ring->tail & (LOG_RING_WORDS - 1)]);
+            ring->lost++;
+        }
+        va_list args;
+        va_start(args, header);
+        _put(header);
+        _put(time_us_32());
+        for (uint i = 0; i < LOG_ENTRY_ARGS(header); i++) _put(va_arg(args, uint32_t));
+        va_end(args);
+    }
+    restore_interrupts(save);
+}
+
+void log_read(uint32_t file_sector, uint8_t *buf) {
+    uint32_t offset = file_sector * SECTOR_SIZE;
+    if (offset < LOG_SIZE) memcpy(buf, (const uint8_t *) ring + offset, MIN(SECTOR_SIZE, LOG_SIZE - offset));
+}
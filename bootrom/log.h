@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LOG_H
+#define _LOG_H
+
+#include <assert.h>
+#include "pico/types.h"
+#include "hardware/regs/addressmap.h"
+
+// Deferred logging (USE_LOG): usb_debug, usb_warn, uf2_debug and printf
+// (runtime.h) store just an id for their format and their arguments, as
+// words, into a ring in the XIP arena (xip_arena.h); formatting is left to
+// the host (host/logdump). The ring is LOG.BIN as it is.
+//
+// Formats go into the log_fmt section, which bootrom.ld links at 0 without
+// loading it, so that a format's address is its id, and the build dumps the
+// section into bootrom.logfmt for the host. Arguments are taken as 32 bit
+// words; for %s that is the string's address, which the host can only show if
+// it has the image.
+
+#define LOG_MAGIC 0x474f4c42 // "BLOG"
+#define LOG_VERSION 1
+#define LOG_RING_WORDS 512
+static_assert(!(LOG_RING_WORDS & (LOG_RING_WORDS - 1)), "");
+#define LOG_MAX_ARGS 8
+
+// An entry is a header word (format id, argument count and level), the time
+// in us, then the arguments
+#define LOG_ENTRY_ID_BITS 0xffffu
+#define LOG_ENTRY_ARGS_LSB 16
+#define LOG_ENTRY_LEVEL_LSB 20
+#define LOG_ENTRY_ARGS(header) (((header) >> LOG_ENTRY_ARGS_LSB) & 0xfu)
+#define LOG_ENTRY_LEVEL(header) (((header) >> LOG_ENTRY_LEVEL_LSB) & 0xfu)
+#define LOG_ENTRY_WORDS(header) (2 + LOG_ENTRY_ARGS(header))
+
+enum log_level {
+    LOG_DEBUG, // usb_debug
+    LOG_UF2,   // uf2_debug
+    LOG_WARN,  // usb_warn
+    LOG_PRINT, // printf
+};
+
+struct log_ring {
+    uint32_t magic;
+    uint16_t version;
+    // of word
+    uint16_t words;
+    // counted in words ever written: the entries from tail up to head are
+    // still in the ring (at their count modulo words)
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    // entries overwritten
+    volatile uint32_t lost;
+    uint32_t word[LOG_RING_WORDS];
+};
+
+#ifdef __arm__
+#define _LOG_ID(format) ((uintptr_t) (format))
+#else
+// elsewhere the section is wherever the linker put it
+extern const char __start_log_fmt[];
+#define _LOG_ID(format) ((uintptr_t) (format) - (uintptr_t) __start_log_fmt)
+#endif
+
+#define _LOG_NARGS(...) _LOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define log_defer(level, format, ...) ({ \
+    static const char __attribute__((section("log_fmt"))) _log_format[] = format; \
+    log_write(_LOG_ID(_log_format) + (_LOG_NARGS(__VA_ARGS__) << LOG_ENTRY_ARGS_LSB) + \
+              ((level) << LOG_ENTRY_LEVEL_LSB), ##__VA_ARGS__); \
+})
+
+// Start an empty log, which until then is off
+void log_init(void);
+
+// An entry: header as above, and its arguments
+void log_write(uint32_t header, ...);
+
+// LOG.BIN
+#define LOG_SIZE sizeof(struct log_ring)
+void log_read(uint32_t file_sector, uint8_t *buf);
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <sys/param.h>
+#include "runtime.h"
+#include "minidump.h"
+#include "xip_arena.h"
+#include "live_export.h"
+
+#define layout (&xip_arena->minidump)
+
+static struct minidump_region *_add_region(uint8_t type, uint8_t core, uint16_t flags, uint32_t addr, uint32_t size) {
+    struct minidump_header *header = &layout->header;
+    // header->size is where the data so far ends, until minidump_init is done
+    uint32_t offset = (header->size + MINIDUMP_SECTOR_SIZE - 1) & ~(MINIDUMP_SECTOR_SIZE - 1);
+    if (header->region_count == MINIDUMP_MAX_REGIONS || offset >= MINIDUMP_MAX_SIZE) return NULL;
+    if (size > MINIDUMP_MAX_SIZE - offset) {
+        size = MINIDUMP_MAX_SIZE - offset;
+        flags |= MINIDUMP_FLAG_TRUNCATED;
+    }
+    struct minidump_region *region = &layout->region[header->region_count++];
+    region->type = type;
+    region->core = core;
+    region->flags = flags;
+    region->addr = addr;
+    region->size = size;
+    region->offset = offset;
+    header->size = offset + size;
+    return region;
+}
+
+// From sp up to top (or MINIDUMP_STACK_WINDOW if top isn't above sp), keeping
+// the end nearest sp (the innermost frames) if it is too big
+static void _add_stack(uint core, uint16_t flags, uint32_t sp, uint32_t top) {
+    if ((sp & 3u) || sp < SRAM_BASE || sp >= SRAM_END) return;
+    if ((top & 3u) || top <= sp || top > SRAM_END) top = MIN(sp + MINIDUMP_STACK_WINDOW, SRAM_END);
+    if (top - sp > MINIDUMP_STACK_MAX) {
+        top = sp + MINIDUMP_STACK_MAX;
+        flags |= MINIDUMP_FLAG_TRUNCATED;
+    }
+    _add_region(MINIDUMP_REGION_STACK, core, flags, sp, top - sp);
+}
+
+#ifdef USE_CRASHDUMP_REGIONS
+// The ones in SRAM that are neither sensitive nor skipped, lowest priority
+// value first
+static void _add_app_regions(const struct crashdump_block *block) {
+    uint32_t count;
+    const struct crashdump_region *regions = crashdump_get_regions(block, &count);
+    for (uint priority = 0; priority < 256; priority++) {
+        for (uint i = 0; i < count; i++) {
+            const struct crashdump_region *r = &regions[i];
+            if (r->priority != priority || (r->flags & (CRASHDUMP_REGION_SENSITIVE | CRASHDUMP_REGION_SKIP)) ||
+                r->addr < SRAM_BASE || r->addr >= SRAM_END) {
+                continue;
+            }
+            struct minidump_region *region = _add_region(MINIDUMP_REGION_APP, 0, 0, r->addr,
+                                                         MIN(r->size, SRAM_END - r->addr));
+            if (region) memcpy(region->name, r->name, sizeof(region->name));
+        }
+    }
+}
+#endif
+
+void minidump_init() {
+    memset0(layout, sizeof(*layout));
+    struct minidump_header *header = &layout->header;
+    header->magic = MINIDUMP_MAGIC;
+    header->version = MINIDUMP_VERSION;
+    header->header_size = sizeof(struct minidump_header);
+    header->region_size = sizeof(struct minidump_region);
+    // the data starts after the sector of descriptors
+    header->size = MINIDUMP_SECTOR_SIZE;
+
+    const struct crashdump_block *block = crashdump_get_block();
+    if (block) {
+        _add_region(MINIDUMP_REGION_BLOCK, block->crashed_core, 0, (uintptr_t) block, MIN(block->size, sizeof(*block)));
+        for (uint core = 0; core < CRASHDUMP_NUM_CORES; core++) {
+            const struct crashdump_regs *regs = &block->core[core];
+            if (regs->state == CRASHDUMP_STATE_NONE) continue;
+            _add_stack(core, 0, regs->msp, regs->stack_top);
+            // EXC_RETURN bit 2: the interrupted code was on the process stack,
+            // whose top we don't know
+            if (regs->exc_return & 4u) _add_stack(core, MINIDUMP_FLAG_PSP, regs->psp, 0);
+        }
+#ifdef USE_CRASHDUMP_REGIONS
+        _add_app_regions(block);
+#endif
+    }
+    if (!header->region_count) header->size = sizeof(struct minidump_header);
+}
+
+uint32_t minidump_size() {
+    return layout->header.size;
+}
+
+void minidump_read(uint32_t file_sector, uint8_t *buf) {
+    if (!file_sector) {
+        memcpy(buf, layout, sizeof(*layout));
+        return;
+    }
+    // at most MINIDUMP_MAX_REGIONS to look at, and each sector is from one
+    uint32_t offset = file_sector * MINIDUMP_SECTOR_SIZE;
+    for (uint i = 0; i < layout->header.region_count; i++) {
+        const struct minidump_region *region = &layout->region[i];
+        uint32_t pos = offset - region->offset;
+        if (offset >= region->offset && pos < region->size) {
+            uint32_t len = MIN(region->size - pos, MINIDUMP_SECTOR_SIZE);
+            live_export_copy(buf, (const uint8_t *) region->addr + pos, len);
+#ifdef USE_CRASHDUMP_REGIONS
+            crashdump_redact(buf, region->addr + pos, len);
+#endif
+            return;
+        }
+    }
+}
+
+#ifdef USE_PICOBOOT_DUMP
+void minidump_dump_read(uint32_t sector, uint8_t *buf) {
+    if (!sector) {
+        struct minidump_layout *dump = (struct minidump_layout *) buf;
+        memset0(dump, MINIDUMP_SECTOR_SIZE);
+        dump->header.magic = MINIDUMP_MAGIC;
+        dump->header.version = MINIDUMP_VERSION;
+        dump->header.header_size = sizeof(struct minidump_header);
+        dump->header.region_size = sizeof(struct minidump_region);
+        dump->header.region_count = 1;
+        dump->header.size = MINIDUMP_DUMP_SIZE;
+        struct minidump_region *region = dump->region;
+        region->type = MINIDUMP_REGION_SRAM;
+        region->addr = SRAM_BASE;
+        region->size = SRAM_END - SRAM_BASE;
+        region->offset = MINIDUMP_SECTOR_SIZE;
+        const struct crashdump_block *block = crashdump_get_block();
+        if (block) {
+            dump->header.region_count = 2;
+            region++;
+            region->type = MINIDUMP_REGION_BLOCK;
+            region->core = block->crashed_core;
+            region->addr = (uintptr_t) block;
+            region->size = MIN(block->size, sizeof(*block));
+            region->offset = MINIDUMP_SECTOR_SIZE + (uintptr_t) block - SRAM_BASE;
+        }
+        return;
+    }
+    uint32_t addr = SRAM_BASE + (sector - 1) * MINIDUMP_SECTOR_SIZE;
+    live_export_copy(buf, (const void *) addr, MINIDUMP_SECTOR_SIZE);
+#ifdef USE_CRASHDUMP_REGIONS
+    crashdump_redact(buf, addr, MINIDUMP_SECTOR_SIZE);
+#endif
+}
+#endif
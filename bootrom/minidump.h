@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MINIDUMP_H
+#define _MINIDUMP_H
+
+#include "pico/types.h"
+#include "hardware/regs/addressmap.h"
+#include "crashdump.h"
+
+// MINIDUMP.BIN: just what triage usually needs (the capture block with the
+// registers, each core's stack from its SP up, and whatever the application
+// registered with CRASHDUMP_REGION), rather than all of SRAM. Sensitive
+// regions are zeroes.
+//
+// The file is a header, the region descriptors, then each region's data. The
+// data starts on a sector boundary for each region, so that any sector of the
+// file is a single copy; the padding is zeroes. The layout is worked out once,
+// by minidump_init, into the XIP arena, and is sector 0 of the file as is.
+//
+// Readers should check magic and version, and use header_size and
+// region_size to find the descriptors, so that later versions can add fields.
+
+#define MINIDUMP_MAGIC 0x504d444d // "MDMP"
+// 2 added minidump_region.name
+#define MINIDUMP_VERSION 2
+
+#define MINIDUMP_SECTOR_SIZE 512u
+#define MINIDUMP_MAX_REGIONS 16
+#ifndef MINIDUMP_MAX_SIZE
+#define MINIDUMP_MAX_SIZE (64u * 1024u)
+#endif
+// a stack is dumped from its SP up to the top the capture block gives, or
+// this much if it gives none (or for the process stack), and no more than
+// MINIDUMP_STACK_MAX
+#define MINIDUMP_STACK_WINDOW 1024u
+#define MINIDUMP_STACK_MAX (8u * 1024u)
+
+// minidump_region.type
+#define MINIDUMP_REGION_BLOCK 1 // the capture block (struct crashdump_block)
+#define MINIDUMP_REGION_STACK 2 // a core's stack, from its SP up
+#define MINIDUMP_REGION_APP   3 // registered by the application, in priority order
+#define MINIDUMP_REGION_SRAM  4 // all of it (the PICOBOOT dump stream)
+
+// minidump_region.flags
+#define MINIDUMP_FLAG_PSP       0x0001u // the process stack, rather than the main one
+#define MINIDUMP_FLAG_TRUNCATED 0x0002u // there was more than fitted
+
+struct minidump_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t region_size;
+    uint16_t region_count;
+    // of the whole file
+    uint32_t size;
+};
+
+struct minidump_region {
+    uint8_t type;
+    // which core, for a stack
+    uint8_t core;
+    uint16_t flags;
+    // where it was in the target's memory
+    uint32_t addr;
+    uint32_t size;
+    // of its data, in the file
+    uint32_t offset;
+    // as the application registered it, for MINIDUMP_REGION_APP
+    char name[12];
+};
+#define MINIDUMP_REGION_V1_SIZE 16
+
+struct minidump_layout {
+    struct minidump_header header;
+    struct minidump_region region[MINIDUMP_MAX_REGIONS];
+};
+static_assert(sizeof(struct minidump_layout) <= MINIDUMP_SECTOR_SIZE, "");
+
+// Work out the layout, for the crash we were entered with (a header with no
+// regions otherwise)
+void minidump_init(void);
+
+uint32_t minidump_size(void);
+
+// One sector of MINIDUMP.BIN; buf must be zeroed
+void minidump_read(uint32_t file_sector, uint8_t *buf);
+
+#ifdef USE_PICOBOOT_DUMP
+// The whole of SRAM in one PICOBOOT command, for collection rigs that would
+// rather not mount the drive: PC_CRASHDUMP_DUMP is a range command, from
+// dAddr (a multiple of MINIDUMP_SECTOR_SIZE) for dSize bytes of a stream of
+// MINIDUMP_DUMP_SIZE, whose data is sent as it is read. The stream is in the
+// same format as MINIDUMP.BIN: a sector of header and descriptors, then all of
+// SRAM as one region, with the capture block's region pointing into it rather
+// than sent twice.
+#define PC_CRASHDUMP_DUMP 0xc0 // IN, and clear of the SDK's ids
+#define MINIDUMP_DUMP_SIZE (MINIDUMP_SECTOR_SIZE + (SRAM_END - SRAM_BASE))
+
+// One sector of the stream
+void minidump_dump_read(uint32_t sector, uint8_t *buf);
+#endif
+
+#endif
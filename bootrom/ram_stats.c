@@ -0,0 +1,34 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ram_stats.h"
+#include "crashdump.h"
+
+// bootrom_rt0.S and bootrom.ld
+extern uint32_t usb_boot_stack[USB_BOOT_STACK_SIZE];
+extern uint32_t usb_boot_sram_sp;
+extern uint8_t __bss_start[], __bss_end[], _stacktop[];
+
+void ram_stats_get(struct ram_stats *stats) {
+    stats->bss_size = __bss_end - __bss_start - sizeof(usb_boot_stack);
+    stats->stack_size = sizeof(usb_boot_stack);
+    // the stack grows down, so the paint left at the bottom was never reached
+    uint i = 0;
+    while (i < USB_BOOT_STACK_SIZE && usb_boot_stack[i] == USB_BOOT_STACK_PAINT) i++;
+    stats->stack_used = (USB_BOOT_STACK_SIZE - i) * 4;
+    stats->sram_stack_used = (uintptr_t) _stacktop - usb_boot_sram_sp;
+
+    stats->sram_touched = RAM_STATS_UNKNOWN;
+    const uint32_t *p = (const uint32_t *) SRAM_BASE;
+    // only if SRAM was filled: after a crash it is the application's
+    if (!crashdump_get_block() && *p == RAM_STATS_FILL((uintptr_t) p)) {
+        uint32_t touched = 0;
+        for (; p < (const uint32_t *) SRAM_END; p++) {
+            if (*p != RAM_STATS_FILL((uintptr_t) p)) touched += 4;
+        }
+        stats->sram_touched = touched;
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _RAM_STATS_H
+#define _RAM_STATS_H
+
+// How much RAM the image itself uses, for STATS.TXT: the whole point is to
+// leave the SRAM being dumped alone, so this is what to check after a change.
+
+// usb_boot_stack, in words (bootrom_rt0.S)
+#define USB_BOOT_STACK_SIZE 300
+// what async_task_worker_thunk paints usb_boot_stack with before switching to
+// it, so the high-water mark is where the paint stops
+#define USB_BOOT_STACK_PAINT 0x5a5aa5a5
+#define RAM_STATS_UNKNOWN 0xffffffffu
+// what _start fills each word of SRAM with on a cold boot
+#define RAM_STATS_FILL(addr) (((uint32_t) (addr) << 16u) | 0xcdabu)
+
+#ifndef __ASSEMBLER__
+#include "runtime.h"
+
+struct ram_stats {
+    // USB RAM used by .bss, less usb_boot_stack
+    uint32_t bss_size;
+    uint32_t stack_size;
+    // high-water mark of usb_boot_stack so far
+    uint32_t stack_used;
+    // SRAM stack in use when async_task_worker_thunk switched to usb_boot_stack
+    uint32_t sram_stack_used;
+    // bytes of SRAM no longer holding _start's fill, or RAM_STATS_UNKNOWN if
+    // there was no fill (after a crash, SRAM is the application's)
+    uint32_t sram_touched;
+};
+
+void ram_stats_get(struct ram_stats *stats);
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "sram_usage.h"
+#include "crashdump.h"
+#include "ram_stats.h"
+#include "xip_arena.h"
+
+#define usage (&xip_overlay->sram_usage)
+
+static const char summary_names[][SRAM_USAGE_NAME] = {
+        "sram_untouched", "untouched_more", "heap_top",
+        "core0_stack_used", "core0_stack_free", "core1_stack_used", "core1_stack_free",
+};
+#define SUMMARY_LINES SRAM_USAGE_SUMMARY_LINES
+static_assert(count_of(summary_names) == SUMMARY_LINES, "");
+
+// the fill of each word is one more in the top half than the last's
+#define FILL_STEP (4u << 16)
+
+static void _add_range(uint32_t start, uint32_t end) {
+    usage->untouched += end - start;
+    if (usage->count < SRAM_USAGE_MAX_RANGES) {
+        usage->range[usage->count].start = start;
+        usage->range[usage->count].end = end;
+        usage->count++;
+    } else {
+        usage->more += end - start;
+    }
+}
+
+// From a stack's top down to the first untouched run is what it used, and the
+// run is how much more it could have used without hitting anything
+static void _scan_stack(uint core, uint32_t top) {
+    usage->stack_used[core] = usage->stack_free[core] = RAM_STATS_UNKNOWN;
+    if ((top & 3u) || top <= SRAM_BASE || top > SRAM_END) return;
+    const uint32_t *p = (const uint32_t *) top;
+    uint32_t run = 0;
+    while (p > (const uint32_t *) SRAM_BASE && run < SRAM_USAGE_MIN_RUN) {
+        p--;
+        run = *p == RAM_STATS_FILL((uintptr_t) p) ? run + 4 : 0;
+    }
+    if (run < SRAM_USAGE_MIN_RUN) return;
+    uint32_t run_top = (uintptr_t) p + run;
+    while (p > (const uint32_t *) SRAM_BASE && p[-1] == RAM_STATS_FILL((uintptr_t) (p - 1))) p--;
+    usage->stack_used[core] = top - run_top;
+    usage->stack_free[core] = run_top - (uintptr_t) p;
+}
+
+static void _scan() {
+    usage->count = usage->untouched = usage->more = 0;
+    usage->heap_top = RAM_STATS_UNKNOWN;
+    uint32_t biggest = 0;
+    const uint32_t *p = (const uint32_t *) SRAM_BASE, *end = (const uint32_t *) SRAM_END;
+    uint32_t fill = RAM_STATS_FILL(SRAM_BASE);
+    while (p < end) {
+        while (p < end && *p != fill) {
+            p++;
+            fill += FILL_STEP;
+        }
+        const uint32_t *start = p;
+        while (p < end && *p == fill) {
+            p++;
+            fill += FILL_STEP;
+        }
+        uint32_t size = (uintptr_t) p - (uintptr_t) start;
+        if (size >= SRAM_USAGE_MIN_RUN) {
+            _add_range((uintptr_t) start, (uintptr_t) p);
+            if (size > biggest) {
+                biggest = size;
+                usage->heap_top = (uintptr_t) start;
+            }
+        }
+    }
+    const struct crashdump_block *block = crashdump_get_block();
+    for (uint core = 0; core < CRASHDUMP_NUM_CORES; core++) {
+        _scan_stack(core, block ? block->core[core].stack_top : 0);
+    }
+}
+
+void sram_usage_flush() {
+    usage->count = SRAM_USAGE_UNSCANNED;
+}
+
+uint32_t sram_usage_size() {
+    if (usage->count == SRAM_USAGE_UNSCANNED) _scan();
+    return (SUMMARY_LINES + usage->count) * SRAM_USAGE_LINE;
+}
+
+static void _render_line(uint8_t *p, uint32_t line) {
+    for (uint i = 0; i < SRAM_USAGE_LINE - 1; i++) p[i] = ' ';
+    p[SRAM_USAGE_LINE - 1] = '\n';
+    uint32_t value;
+    if (line < SUMMARY_LINES) {
+        for (uint i = 0; i < SRAM_USAGE_NAME && summary_names[line][i]; i++) p[i] = summary_names[line][i];
+        const uint32_t values[] = {
+                usage->untouched, usage->more, usage->heap_top,
+                usage->stack_used[0], usage->stack_free[0], usage->stack_used[1], usage->stack_free[1],
+        };
+        static_assert(count_of(values) == SUMMARY_LINES, "");
+        value = values[line];
+    } else {
+        line -= SUMMARY_LINES;
+        memcpy(p, "untouched_", 10);
+        hex(p + 10, usage->range[line].start, 8);
+        value = usage->range[line].end - usage->range[line].start;
+    }
+    hex(p + SRAM_USAGE_NAME + 1, value, 8);
+}
+
+void sram_usage_read(uint32_t file_sector, uint8_t *buf) {
+    uint32_t first = file_sector * (SECTOR_SIZE / SRAM_USAGE_LINE);
+    uint32_t lines = sram_usage_size() / SRAM_USAGE_LINE;
+    for (uint32_t n = first; n < lines && n < first + SECTOR_SIZE / SRAM_USAGE_LINE; n++) {
+        _render_line(buf + (n - first) * SRAM_USAGE_LINE, n);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _SRAM_USAGE_H
+#define _SRAM_USAGE_H
+
+#include "runtime.h"
+
+// USAGE.TXT: what the application never wrote, going by the words of SRAM
+// still holding _start's fill from the cold boot before it (RAM_STATS_FILL).
+// STATS.TXT's layout, first the totals and estimates:
+//
+//      sram_untouched          bytes in all the untouched ranges
+//      untouched_more          of those, in ranges past SRAM_USAGE_MAX_RANGES
+//      heap_top                start of the biggest untouched range
+//      coreN_stack_used        from the stack top down to the first untouched range
+//      coreN_stack_free        the size of that range
+//
+// (ffffffff where unknown: the stack tops come from the capture block) then
+// each range, as untouched_<start> and its size. Only runs of at least
+// SRAM_USAGE_MIN_RUN count, as data often has the odd word never written.
+//
+// The heap estimate assumes the SDK's layout, the heap growing up from .bss
+// towards the stacks, so the biggest gap is what the heap never reached.
+//
+// Scanned on first use, and kept in the XIP overlay (xip_arena.h) until
+// flushed.
+
+#define SRAM_USAGE_LINE 32
+#define SRAM_USAGE_NAME 22
+#define SRAM_USAGE_MIN_RUN 64u
+#define SRAM_USAGE_MAX_RANGES 64
+// ahead of the ranges
+#define SRAM_USAGE_SUMMARY_LINES 7
+#define SRAM_USAGE_UNSCANNED 0xffffffffu
+
+struct sram_usage {
+    // ranges, or SRAM_USAGE_UNSCANNED
+    uint32_t count;
+    uint32_t untouched;
+    uint32_t more;
+    uint32_t heap_top;
+    uint32_t stack_used[2];
+    uint32_t stack_free[2];
+    struct {
+        uint32_t start;
+        uint32_t end;
+    } range[SRAM_USAGE_MAX_RANGES];
+};
+
+// Scan again next time, as SRAM may have changed
+void sram_usage_flush(void);
+
+// Of USAGE.TXT, scanning if need be
+uint32_t sram_usage_size(void);
+
+// One sector of USAGE.TXT; buf must be zeroed
+void sram_usage_read(uint32_t file_sector, uint8_t *buf);
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "trace.h"
+#include "runtime.h"
+#include "xip_arena.h"
+
+#define ti (&xip_overlay->trace)
+
+static_assert(TRACE_MAX_EVENTS <= 0x10000, "sector_start is 16 bit");
+
+static bool _ring_ok(const uint32_t *p) {
+    const struct trace_ring_header *ring = (const struct trace_ring_header *) p;
+    if (ring->self != (uintptr_t) p || ring->core > 1) return false;
+    uint32_t events = ring->events;
+    if (!events || (events & (events - 1))) return false;
+    return events <= (SRAM_END - (uintptr_t) (ring + 1)) / sizeof(struct trace_event);
+}
+
+static const struct trace_event *_event(uint core, uint32_t n) {
+    const struct trace_ring_header *ring = ti->ring[core];
+    return (const struct trace_event *) (ring + 1) + (n & (ring->events - 1));
+}
+
+// the core with the older of the two rings' next events
+static uint _next_core(const uint32_t *n) {
+    if (n[0] == ti->end[0]) return 1;
+    if (n[1] == ti->end[1]) return 0;
+    // the timer wraps every 71 minutes
+    return (int32_t) (_event(1, n[1])->time - _event(0, n[0])->time) < 0;
+}
+
+static void _scan() {
+    ti->count = 0;
+    ti->ring[0] = ti->ring[1] = NULL;
+    for (const uint32_t *p = (const uint32_t *) SRAM_BASE; p < (const uint32_t *) SRAM_END - 5; p++) {
+        if (*p == TRACE_MAGIC && _ring_ok(p)) {
+            ti->ring[((const struct trace_ring_header *) p)->core] = (const struct trace_ring_header *) p;
+        }
+    }
+    uint32_t n[2];
+    for (uint core = 0; core < 2; core++) {
+        const struct trace_ring_header *ring = ti->ring[core];
+        ti->first[core] = ti->end[core] = n[core] = 0;
+        if (!ring) continue;
+        uint32_t count = ring->count;
+        uint32_t kept = count < ring->events ? count : ring->events - 1;
+        if (kept > TRACE_MAX_EVENTS) kept = TRACE_MAX_EVENTS;
+        ti->end[core] = count;
+        ti->first[core] = n[core] = count - kept;
+        ti->count += kept;
+    }
+    // where each sector starts, by merging (record r is on sector 1 + r / per sector)
+    for (uint32_t r = 0; r < ti->count; r++) {
+        if (!(r % TRACE_RECORDS_PER_SECTOR)) {
+            for (uint core = 0; core < 2; core++) {
+                ti->sector_start[r / TRACE_RECORDS_PER_SECTOR][core] = n[core] - ti->first[core];
+            }
+        }
+        n[_next_core(n)]++;
+    }
+}
+
+void trace_flush() {
+    ti->count = TRACE_UNSCANNED;
+}
+
+uint32_t trace_size() {
+    if (ti->count == TRACE_UNSCANNED) _scan();
+    if (!ti->ring[0] && !ti->ring[1]) return 0;
+    return TRACE_SECTOR_SIZE + ti->count * sizeof(struct trace_record);
+}
+
+void trace_read(uint32_t file_sector, uint8_t *buf) {
+    if (!trace_size()) return;
+    if (!file_sector) {
+        struct trace_file_header *header = (struct trace_file_header *) buf;
+        header->magic = TRACE_MAGIC;
+        header->version = TRACE_VERSION;
+        header->header_size = sizeof(struct trace_file_header);
+        header->record_size = sizeof(struct trace_record);
+        header->record_count = ti->count;
+        for (uint core = 0; core < 2; core++) {
+            header->ring[core] = (uintptr_t) ti->ring[core];
+            header->first[core] = ti->first[core];
+        }
+        return;
+    }
+    uint32_t r = (file_sector - 1) * TRACE_RECORDS_PER_SECTOR;
+    if (r >= ti->count) return;
+    uint32_t n[2];
+    for (uint core = 0; core < 2; core++) {
+        n[core] = ti->first[core] + ti->sector_start[file_sector - 1][core];
+    }
+    struct trace_record *record = (struct trace_record *) buf;
+    for (uint i = 0; i < TRACE_RECORDS_PER_SECTOR && r + i < ti->count; i++, record++) {
+        uint core = _next_core(n);
+        const struct trace_event *event = _event(core, n[core]);
+        record->time = event->time;
+        record->arg = event->arg;
+        record->id = event->id;
+        record->core = core;
+        record->seq = n[core]++;
+    }
+}
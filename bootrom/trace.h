@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <assert.h>
+#include "pico/types.h"
+#include "hardware/regs/addressmap.h"
+
+// The application's trace rings (capture/crash_trace.h): one per core, in
+// .uninitialized_data so they survive into the crash dump image. Each is a
+// header, which the image finds by scanning SRAM for TRACE_MAGIC followed by
+// the header's own address, then a power of two of events, written round and
+// round; count is how many have ever been written.
+//
+// TRACE.BIN has both rings merged in time order: a sector with the file
+// header, then the records. When a ring has wrapped, its oldest slot is left
+// out, as the other core may have been frozen half way through overwriting it.
+
+#define TRACE_MAGIC 0x45435254 // "TRCE"
+#define TRACE_VERSION 1
+
+struct trace_ring_header {
+    uint32_t magic;
+    // where this header is, so that a stray TRACE_MAGIC doesn't match
+    uint32_t self;
+    uint32_t core;
+    // slots, a power of two
+    uint32_t events;
+    volatile uint32_t count;
+};
+
+struct trace_event {
+    // timer_hw->timerawl, in us
+    uint32_t time;
+    // only the bottom 16 bits make it into TRACE.BIN
+    uint32_t id;
+    uint32_t arg;
+};
+
+// TRACE.BIN
+
+// any more of a ring's events are left out
+#define TRACE_MAX_EVENTS 2048u
+#define TRACE_SECTOR_SIZE 512u
+#define TRACE_RECORDS_PER_SECTOR (TRACE_SECTOR_SIZE / sizeof(struct trace_record))
+#define TRACE_MAX_SECTORS (1 + 2 * TRACE_MAX_EVENTS / TRACE_RECORDS_PER_SECTOR)
+#define TRACE_MAX_SIZE (TRACE_MAX_SECTORS * TRACE_SECTOR_SIZE)
+
+struct trace_file_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t record_size;
+    uint16_t _reserved;
+    uint32_t record_count;
+    // per core: where its ring was (0 if not found), and the first event's
+    // number, so record.seq - first is how many before it were lost
+    uint32_t ring[2];
+    uint32_t first[2];
+};
+
+struct trace_record {
+    uint32_t time;
+    uint32_t arg;
+    uint16_t id;
+    uint8_t core;
+    uint8_t _reserved;
+    // the event's number on its core
+    uint32_t seq;
+};
+static_assert(sizeof(struct trace_record) == 16, "");
+
+// The merge, worked out on first use into the XIP overlay (xip_arena.h): the
+// ring positions at which each sector of TRACE.BIN starts
+struct trace_index {
+    // records, or TRACE_UNSCANNED
+    uint32_t count;
+    const struct trace_ring_header *ring[2];
+    // the numbers of the oldest event and of the one after the newest
+    uint32_t first[2];
+    uint32_t end[2];
+    // as offsets from first
+    uint16_t sector_start[TRACE_MAX_SECTORS - 1][2];
+};
+#define TRACE_UNSCANNED 0xffffffffu
+
+// Look for the rings again next time, as SRAM may have changed
+void trace_flush(void);
+
+// Of TRACE.BIN, scanning if need be; 0 without any rings
+uint32_t trace_size(void);
+
+// One sector of TRACE.BIN; buf must be zeroed
+void trace_read(uint32_t file_sector, uint8_t *buf);
+
+#endif
@@ -4,14 +4,23 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <sys/param.h>
 #include "boot/picoboot.h"
 #include "runtime.h"
 #include "usb_device.h"
 #include "async_task.h"
+#include "crashdump.h"
 #include "program_flash_generic.h"
 #include "usb_boot_device.h"
 #include "usb_msc.h"
 #include "usb_stream_helper.h"
+#include "xxd_render.h"
+#ifdef USE_GDB_STUB
+#include "gdb_stub.h"
+#endif
+#ifdef USE_PICOBOOT_DUMP
+#include "xip_arena.h"
+#endif
 #include "hardware/regs/sysinfo.h"
 
 // mutable serial number string for us to initialize on startup
@@ -33,14 +42,50 @@ struct usb_simple_interface_descriptor {
 } __packed;
 
 #ifdef USE_PICOBOOT
-#define BOOT_DEVICE_NUM_INTERFACES 2
+#define BOOT_DEVICE_NUM_SIMPLE_INTERFACES 2
+#else
+#define BOOT_DEVICE_NUM_SIMPLE_INTERFACES 1
+#endif
+
+#ifdef USE_GDB_STUB
+#ifndef USE_PICOBOOT
+#error USE_GDB_STUB requires USE_PICOBOOT (for its interface and endpoint numbers)
+#endif
+// the gdb stub's CDC-ACM function, after the simple interfaces: a
+// communication interface with its (never used) notification endpoint, and a
+// data interface with the bulk pair
+#define BOOT_DEVICE_NUM_INTERFACES (BOOT_DEVICE_NUM_SIMPLE_INTERFACES + 2)
+#define GDB_COMM_INTERFACE_NUM BOOT_DEVICE_NUM_SIMPLE_INTERFACES
+
+struct usb_interface_assoc_descriptor {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bFirstInterface;
+    uint8_t bInterfaceCount;
+    uint8_t bFunctionClass;
+    uint8_t bFunctionSubClass;
+    uint8_t bFunctionProtocol;
+    uint8_t iFunction;
+} __packed;
+
+struct usb_cdc_acm_function_descriptor {
+    struct usb_interface_assoc_descriptor assoc_desc;
+    struct usb_interface_descriptor comm_desc;
+    // header, call management, abstract control management and union
+    uint8_t functional_desc[5 + 5 + 4 + 5];
+    struct usb_endpoint_descriptor notify_ep_desc;
+    struct usb_simple_interface_descriptor data;
+} __packed;
 #else
-#define BOOT_DEVICE_NUM_INTERFACES 1
+#define BOOT_DEVICE_NUM_INTERFACES BOOT_DEVICE_NUM_SIMPLE_INTERFACES
 #endif
 
 struct boot_device_config {
     struct usb_configuration_descriptor config_desc;
-    struct usb_simple_interface_descriptor interface_desc[BOOT_DEVICE_NUM_INTERFACES];
+    struct usb_simple_interface_descriptor interface_desc[BOOT_DEVICE_NUM_SIMPLE_INTERFACES];
+#ifdef USE_GDB_STUB
+    struct usb_cdc_acm_function_descriptor gdb_desc;
+#endif
 } __packed;
 
 static const struct boot_device_config boot_device_config = {
@@ -115,12 +160,90 @@ static const struct boot_device_config boot_device_config = {
                         }
                 }
 #endif
-        }
+        },
+#ifdef USE_GDB_STUB
+        .gdb_desc = {
+                .assoc_desc = {
+                        .bLength           = 0x08,
+                        .bDescriptorType   = 0x0b, // INTERFACE ASSOCIATION Descriptor Type
+                        .bFirstInterface   = GDB_COMM_INTERFACE_NUM,
+                        .bInterfaceCount   = 0x02,
+                        .bFunctionClass    = 0x02, // Communications
+                        .bFunctionSubClass = 0x02, // Abstract Control Model
+                        .bFunctionProtocol = 0x00, // no protocol
+                        .iFunction         = 0x00,
+                },
+                .comm_desc = {
+                        .bLength            = 0x09,
+                        .bDescriptorType    = 0x04, // INTERFACE Descriptor Type
+                        .bInterfaceNumber   = GDB_COMM_INTERFACE_NUM,
+                        .bAlternateSetting  = 0x00,
+                        .bNumEndpoints      = 0x01,
+                        .bInterfaceClass    = 0x02, // Communications
+                        .bInterfaceSubClass = 0x02, // Abstract Control Model
+                        .bInterfaceProtocol = 0x00, // no protocol
+                        .iInterface         = 0x00,
+                },
+                .functional_desc = {
+                        // header, CDC 1.10
+                        0x05, 0x24, 0x00, 0x10, 0x01,
+                        // call management: none, the data interface
+                        0x05, 0x24, 0x01, 0x00, GDB_COMM_INTERFACE_NUM + 1,
+                        // abstract control management: line coding and state only
+                        0x04, 0x24, 0x02, 0x02,
+                        // union of the communication and data interfaces
+                        0x05, 0x24, 0x06, GDB_COMM_INTERFACE_NUM, GDB_COMM_INTERFACE_NUM + 1,
+                },
+                .notify_ep_desc = {
+                        .bLength          = 0x07,
+                        .bDescriptorType  = 0x05,   // ENDPOINT Descriptor Type
+                        .bEndpointAddress = 0x85,   // This is an IN endpoint with endpoint number 5
+                        .bmAttributes     = 0x03,   // Types - INTERRUPT
+                        .wMaxPacketSize   = 0x0008,
+                        .bInterval        = 0x10,
+                },
+                .data = {
+                        .desc = {
+                                .bLength            = 0x09,
+                                .bDescriptorType    = 0x04, // INTERFACE Descriptor Type
+                                .bInterfaceNumber   = GDB_COMM_INTERFACE_NUM + 1,
+                                .bAlternateSetting  = 0x00,
+                                .bNumEndpoints      = 0x02,
+                                .bInterfaceClass    = 0x0a, // CDC Data
+                                .bInterfaceSubClass = 0x00,
+                                .bInterfaceProtocol = 0x00,
+                                .iInterface         = 0x00,
+                        },
+                        .ep1_desc = {
+                                .bLength          = 0x07,
+                                .bDescriptorType  = 0x05,   // ENDPOINT Descriptor Type
+                                .bEndpointAddress = 0x06,   // This is an OUT endpoint with endpoint number 6
+                                .bmAttributes     = 0x02,   // Types - BULK
+                                .wMaxPacketSize   = 0x0040,
+                                .bInterval        = 0x00,
+                        },
+                        .ep2_desc = {
+                                .bLength          = 0x07,
+                                .bDescriptorType  = 0x05,   // ENDPOINT Descriptor Type
+                                .bEndpointAddress = 0x87,   // This is an IN endpoint with endpoint number 7
+                                .bmAttributes     = 0x02,   // Types - BULK
+                                .wMaxPacketSize   = 0x0040,
+                                .bInterval        = 0x00,
+                        },
+                },
+        },
+#endif
 };
 
 static_assert(sizeof(boot_device_config) == sizeof(struct usb_configuration_descriptor) +
-                                            BOOT_DEVICE_NUM_INTERFACES * sizeof(struct usb_simple_interface_descriptor),
-              "");
+                                            BOOT_DEVICE_NUM_SIMPLE_INTERFACES * sizeof(struct usb_simple_interface_descriptor)
+#ifdef USE_GDB_STUB
+                                            + sizeof(struct usb_cdc_acm_function_descriptor)
+#endif
+              , "");
+#ifdef USB_LARGE_DESCRIPTOR_SIZE
+static_assert(sizeof(boot_device_config) <= USB_LARGE_DESCRIPTOR_SIZE, "");
+#endif
 
 static struct usb_interface msd_interface;
 
@@ -129,13 +252,24 @@ static struct usb_endpoint picoboot_in, picoboot_out;
 static struct usb_interface picoboot_interface;
 #endif
 
+#ifdef USE_GDB_STUB
+static struct usb_endpoint gdb_notify_ep;
+static struct usb_interface gdb_comm_interface, gdb_data_interface;
+#endif
+
 static const struct usb_device_descriptor boot_device_descriptor = {
         .bLength            = 18, // Descriptor size is 18 bytes
         .bDescriptorType    = 0x01, // DEVICE Descriptor Type
         .bcdUSB             = 0x0110, // USB Specification version 1.1
+#ifndef USE_GDB_STUB
         .bDeviceClass       = 0x00, // Each interface specifies its own class information
         .bDeviceSubClass    = 0x00, // Each interface specifies its own Subclass information
         .bDeviceProtocol    = 0x00, // No protocols the device basis
+#else
+        .bDeviceClass       = 0xef, // Miscellaneous, for the CDC-ACM function's interface association
+        .bDeviceSubClass    = 0x02, // Common Class
+        .bDeviceProtocol    = 0x01, // Interface Association Descriptor
+#endif
         .bMaxPacketSize0    = 0x40, // Maximum packet size for endpoint zero is 64
         .idVendor           = VENDOR_ID,
         .idProduct          = PRODUCT_ID,
@@ -278,6 +412,46 @@ __rom_function_static_impl(bool, _picoboot_on_stream_chunk)(uint32_t chunk_len _
     return true;
 }
 
+#ifdef USE_PICOBOOT_DUMP
+// Each chunk is a sector of the stream, read as it is sent (no task: it is
+// only SRAM, as for MSC's sectors)
+__rom_function_static_impl(bool, _picoboot_dump_on_chunk)(__unused uint32_t chunk_len __comma_removed_for_space(
+        struct usb_stream_transfer *transfer)) {
+    minidump_dump_read(_picoboot_stream_transfer.task.transfer_addr / MINIDUMP_SECTOR_SIZE,
+                       xip_arena->picoboot_dump);
+    _picoboot_stream_transfer.task.transfer_addr += MINIDUMP_SECTOR_SIZE;
+    return false;
+}
+
+// PC_CRASHDUMP_DUMP (minidump.h): whether the command was good, and the
+// stream started
+static bool _picoboot_dump(const struct picoboot_cmd *cmd) {
+    uint32_t offset = cmd->range_cmd.dAddr, len = cmd->range_cmd.dSize;
+    if (cmd->bCmdSize != sizeof(struct picoboot_range_cmd)) {
+        _set_cmd_status(PICOBOOT_INVALID_CMD_LENGTH);
+    } else if (!len || len != cmd->dTransferLength) {
+        _set_cmd_status(PICOBOOT_INVALID_TRANSFER_LENGTH);
+    } else if (offset > MINIDUMP_DUMP_SIZE || len > MINIDUMP_DUMP_SIZE - offset) {
+        _set_cmd_status(PICOBOOT_INVALID_ADDRESS);
+    } else if (offset % MINIDUMP_SECTOR_SIZE) {
+        _set_cmd_status(PICOBOOT_BAD_ALIGNMENT);
+    } else {
+        static const struct usb_stream_transfer_funcs _picoboot_dump_funcs = {
+                .on_packet_complete = usb_stream_noop_on_packet_complete,
+                .on_chunk = __rom_function_ref(_picoboot_dump_on_chunk)
+        };
+        _set_cmd_status(PICOBOOT_OK);
+        _picoboot_current_cmd_status.bInProgress = true;
+        usb_stream_setup_transfer(&_picoboot_stream_transfer.stream, &_picoboot_dump_funcs,
+                                  xip_arena->picoboot_dump, MINIDUMP_SECTOR_SIZE, len, _tf_ack);
+        _picoboot_stream_transfer.stream.ep = &picoboot_in;
+        usb_start_transfer(&picoboot_in, &_picoboot_stream_transfer.stream.core);
+        return true;
+    }
+    return false;
+}
+#endif
+
 static void _picoboot_cmd_packet_internal(struct usb_endpoint *ep) {
     struct usb_buffer *buffer = usb_current_out_packet_buffer(ep);
     uint len = buffer->data_len;
@@ -299,6 +473,10 @@ static void _picoboot_cmd_packet_internal(struct usb_endpoint *ep) {
         static_assert(
                 offsetof(struct picoboot_cmd, range_cmd.dAddr) == offsetof(struct picoboot_cmd, address_only_cmd.dAddr),
                 ""); // we want transfer_addr == exec_cmd.addr also
+#ifdef USE_PICOBOOT_DUMP
+        // (its id is past the end of cmd_mapping, so a bad one stalls below)
+        if (cmd->bCmdId == PC_CRASHDUMP_DUMP && _picoboot_dump(cmd)) return;
+#endif
         uint type = 0;
         static_assert(1u == (PC_EXCLUSIVE_ACCESS & 0xfu), "");
         static_assert(2u == (PC_REBOOT & 0xfu), "");
@@ -380,11 +558,52 @@ __rom_function_static_impl(void, _picoboot_cmd_packet)(struct usb_endpoint *ep)
 
 #endif
 
+#ifdef USE_GDB_STUB
+
+#define CDC_SET_LINE_CODING 0x20
+#define CDC_GET_LINE_CODING 0x21
+#define CDC_SET_CONTROL_LINE_STATE 0x22
+
+// The stub doesn't care about any of it, but hosts expect a serial port to
+// take its line settings
+static bool _gdb_comm_setup_request_handler(__unused struct usb_interface *interface, struct usb_setup_packet *setup) {
+    setup = __builtin_assume_aligned(setup, 4);
+    if (USB_REQ_TYPE_TYPE_CLASS == (setup->bmRequestType & USB_REQ_TYPE_TYPE_MASK)) {
+        if (setup->bRequest == CDC_SET_LINE_CODING) {
+            usb_start_control_out_transfer(&usb_current_packet_only_transfer_type);
+            return true;
+        }
+        if (setup->bRequest == CDC_GET_LINE_CODING) {
+            // 115200 baud, 1 stop bit, no parity, 8 data bits
+            static const uint8_t line_coding[7] = {0x00, 0xc2, 0x01, 0x00, 0, 0, 8};
+            uint len = MIN(setup->wLength, sizeof(line_coding));
+            uint8_t *buffer = usb_get_single_packet_response_buffer(usb_get_control_in_endpoint(), len);
+            memcpy(buffer, line_coding, len);
+            usb_start_single_buffer_control_in_transfer();
+            return true;
+        }
+        if (setup->bRequest == CDC_SET_CONTROL_LINE_STATE) {
+            usb_start_empty_control_in_transfer_null_completion();
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
+
 static void _usb_boot_on_configure(struct usb_device *device, bool configured) {
+#ifdef USE_AUTO_RESUME
+    // first, so the drive's files (MINIDUMP.BIN's layout) see the block again
+    if (configured) crashdump_on_configure();
+#endif
     msc_on_configure(device, configured);
 #ifdef USE_PICOBOOT
     if (configured) _picoboot_reset();
 #endif
+#ifdef USE_GDB_STUB
+    gdb_stub_on_configure(configured);
+#endif
 }
 
 static void _write_six_msb_hex_chars(char *dest, uint32_t val) {
@@ -458,19 +677,46 @@ void usb_boot_device_init(uint32_t _usb_disable_interface_mask) {
                 &picoboot_out,
                 &picoboot_in,
         };
+#ifndef USE_GDB_STUB
         usb_interface_init(&picoboot_interface, &config_desc->interface_desc[picoboot_interface_num].desc,
                            picoboot_endpoints, count_of(picoboot_endpoints), true);
+#else
+        // single buffered, so that the gdb stub's endpoints fit in the DPRAM too
+        usb_interface_init(&picoboot_interface, &config_desc->interface_desc[picoboot_interface_num].desc,
+                           picoboot_endpoints, count_of(picoboot_endpoints), false);
+#endif
         static struct usb_transfer _picoboot_cmd_transfer;
         _picoboot_cmd_transfer.type = &_picoboot_cmd_transfer_type;
         usb_set_default_transfer(&picoboot_out, &_picoboot_cmd_transfer);
         picoboot_interface.setup_request_handler = _picoboot_setup_request_handler;
     }
 #endif
+#ifdef USE_GDB_STUB
+    {
+        static struct usb_endpoint *const gdb_comm_endpoints[] = {
+                &gdb_notify_ep,
+        };
+        static struct usb_endpoint *const gdb_data_endpoints[] = {
+                gdb_stub_endpoints,
+                gdb_stub_endpoints + 1,
+        };
+        usb_interface_init(&gdb_comm_interface, &boot_device_config.gdb_desc.comm_desc, gdb_comm_endpoints,
+                           count_of(gdb_comm_endpoints), false);
+        gdb_comm_interface.setup_request_handler = _gdb_comm_setup_request_handler;
+        usb_interface_init(&gdb_data_interface, &boot_device_config.gdb_desc.data.desc, gdb_data_endpoints,
+                           count_of(gdb_data_endpoints), false);
+        gdb_stub_init();
+    }
+#endif
 
     static struct usb_interface *const boot_device_interfaces[] = {
             &msd_interface,
 #ifdef USE_PICOBOOT
             &picoboot_interface,
+#endif
+#ifdef USE_GDB_STUB
+            &gdb_comm_interface,
+            &gdb_data_interface,
 #endif
     };
     static_assert(count_of(boot_device_interfaces) == BOOT_DEVICE_NUM_INTERFACES, "");
@@ -483,6 +729,21 @@ void usb_boot_device_init(uint32_t _usb_disable_interface_mask) {
     usb_device_start();
 }
 
+void usb_boot_device_start(uint32_t _usb_disable_interface_mask) {
+    usb_boot_device_init(_usb_disable_interface_mask);
+#ifdef USE_CRASHDUMP_REGIONS
+    // before core1 starts rendering
+    crashdump_regions_init();
+#endif
+#ifdef USE_XXD_RENDER
+    if (crashdump_get_block()) xxd_render_start();
+#endif
+#ifdef USE_AUTO_RESUME
+    // last (usb_boot_device.h)
+    crashdump_arm_enumeration_timeout();
+#endif
+}
+
 uint8_t *usb_get_single_packet_response_buffer(struct usb_endpoint *ep, uint len) {
     struct usb_buffer *buffer = usb_current_in_packet_buffer(ep);
     assert(len <= buffer->data_max);
@@ -492,5 +753,10 @@ uint8_t *usb_get_single_packet_response_buffer(struct usb_endpoint *ep, uint len
 }
 
 void safe_reboot(uint32_t addr, uint32_t sp, uint32_t delay_ms) {
+#ifndef USE_LIVE_EXPORT
     watchdog_reboot(addr, sp, delay_ms);
+#else
+    // the application's to decide (live_export.h)
+    (void) addr, (void) sp, (void) delay_ms;
+#endif
 }
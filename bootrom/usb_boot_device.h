@@ -14,6 +14,12 @@
 
 void usb_boot_device_init(uint32_t _usb_disable_interface_mask);
 
+// usb_boot_device_init, and what depends on the crash, in the order that
+// matters (for _usb_boot, and usb_sim): the sensitive regions and core1's
+// rendering come before arming the enumeration timeout, which may take us
+// back to the application (crashdump_resume)
+void usb_boot_device_start(uint32_t _usb_disable_interface_mask);
+
 void safe_reboot(uint32_t addr, uint32_t sp, uint32_t delay_ms);
 
 // note these are inclusive to save - 1 checks... we always test the start and end of a range, so the range would have to be zero length which we don't use
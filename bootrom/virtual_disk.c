@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include <sys/param.h>
 #include "runtime.h"
 #include "usb_boot_device.h"
 #include "virtual_disk.h"
@@ -11,6 +12,16 @@
 #include "scsi.h"
 #include "usb_msc.h"
 #include "async_task.h"
+#include "crashdump.h"
+#include "crash_ring.h"
+#include "xxd_render.h"
+#include "xip_arena.h"
+#include "live_export.h"
+#include "ram_stats.h"
+#include "minidump.h"
+#include "backtrace.h"
+#include "sram_usage.h"
+#include "trace.h"
 #include "generated.h"
 
 // Fri, 05 Sep 2008 16:20:51
@@ -29,19 +40,106 @@ static_assert(CLUSTER_SIZE == SECTOR_SIZE << CLUSTER_SHIFT, "");
 #define CLUS_INDEX 2
 #ifdef USE_INFO_UF2
 #define CLUS_INFO  3
-#define CLUS_CRASH_START 4
+#define CLUS_REGS  4
 #else
-#define CLUS_CRASH_START 3
+#define CLUS_REGS  3
+#endif
+#define CLUS_STATS (CLUS_REGS + 1)
+#ifdef USE_MINIDUMP
+// room for the biggest MINIDUMP.BIN, of which only what is used is allocated
+#define MINIDUMP_CLUSTERS (MINIDUMP_MAX_SIZE / CLUSTER_SIZE)
+static_assert(!(MINIDUMP_MAX_SIZE % CLUSTER_SIZE), "");
+#define CLUS_MINIDUMP_START (CLUS_STATS + 1)
+#define CLUS_MINIDUMP_LAST (CLUS_MINIDUMP_START + MINIDUMP_CLUSTERS - 1)
+#define CLUS_AFTER_MINIDUMP (CLUS_MINIDUMP_LAST + 1)
+#else
+#define CLUS_AFTER_MINIDUMP (CLUS_STATS + 1)
+#endif
+#ifdef USE_BACKTRACE
+#define CLUS_BACKTRACE CLUS_AFTER_MINIDUMP
+#define CLUS_AFTER_BACKTRACE (CLUS_BACKTRACE + 1)
+static_assert(BACKTRACE_MAX_LINES * BACKTRACE_LINE <= CLUSTER_SIZE, "");
+#else
+#define CLUS_AFTER_BACKTRACE CLUS_AFTER_MINIDUMP
+#endif
+#ifdef USE_SRAM_USAGE
+#define CLUS_USAGE CLUS_AFTER_BACKTRACE
+#define CLUS_AFTER_USAGE (CLUS_USAGE + 1)
+static_assert((SRAM_USAGE_SUMMARY_LINES + SRAM_USAGE_MAX_RANGES) * SRAM_USAGE_LINE <= CLUSTER_SIZE, "");
+#else
+#define CLUS_AFTER_USAGE CLUS_AFTER_BACKTRACE
+#endif
+#ifdef USE_TRACE
+// as MINIDUMP.BIN, room for the biggest TRACE.BIN
+#define TRACE_CLUSTERS ((TRACE_MAX_SIZE + CLUSTER_SIZE - 1) / CLUSTER_SIZE)
+#define CLUS_TRACE_START CLUS_AFTER_USAGE
+#define CLUS_TRACE_LAST (CLUS_TRACE_START + TRACE_CLUSTERS - 1)
+#define CLUS_AFTER_TRACE (CLUS_TRACE_LAST + 1)
+static_assert(TRACE_SECTOR_SIZE == SECTOR_SIZE, "");
+#else
+#define CLUS_AFTER_TRACE CLUS_AFTER_USAGE
+#endif
+#ifdef USE_LOG
+#define CLUS_LOG CLUS_AFTER_TRACE
+#define CLUS_CRASH_START (CLUS_LOG + 1)
+static_assert(LOG_SIZE <= CLUSTER_SIZE, "");
+#else
+#define CLUS_CRASH_START CLUS_AFTER_TRACE
 #endif
 
+// REGS.TXT has one sector per core, of fixed width lines
+#define REGS_TXT_LINE 16
+#define REGS_LEN (CRASHDUMP_NUM_CORES * SECTOR_SIZE)
+static_assert(REGS_LEN <= CLUSTER_SIZE, "");
+
+// STATS.TXT is fixed width lines too, wider for the longer names
+#define STATS_TXT_LINE 32
+#define STATS_TXT_NAME 22
+
 // See format below for "xxd" function
 #define XXD_CHARS_PER_BYTE 4
 #define BYTES_DUMPED_PER_SECTOR  (SECTOR_SIZE / XXD_CHARS_PER_BYTE)
 #define BYTES_DUMPED_PER_CLUSTER (CLUSTER_SIZE / XXD_CHARS_PER_BYTE)
 #define MEM_SIZE (SRAM_END - SRAM_BASE)
-#define CLUS_CRASH_LAST (CLUS_CRASH_START + (MEM_SIZE / BYTES_DUMPED_PER_CLUSTER))
+#define CLUS_CRASH_LAST (CLUS_CRASH_START + (MEM_SIZE / BYTES_DUMPED_PER_CLUSTER) - 1)
+static_assert(!(MEM_SIZE % BYTES_DUMPED_PER_CLUSTER), "");
 #define CRASH_LEN (XXD_CHARS_PER_BYTE * MEM_SIZE)
 
+#define CRASH_SECTORS ((CLUS_CRASH_LAST + 1 - CLUS_CRASH_START) << CLUSTER_SHIFT)
+static_assert(CRASH_SECTORS == XXD_RENDER_SECTORS, "");
+
+#ifdef USE_AUTO_RESUME
+// One bit per sector of CRASHDMP.XXD, set once the host has read it
+static_assert(CRASH_SECTORS / 8 <= sizeof(xip_arena->vd_coverage), "");
+#endif
+
+#ifdef USE_CRASH_UF2
+// Then CRASHDMP.UF2, the same SRAM as a UF2 to load it back with: a block per
+// sector, each of 256 bytes, tagged with the capture block's address
+#define CRASH_UF2_BLOCKS ((MEM_SIZE + 255) / 256)
+#define CRASH_UF2_LEN (CRASH_UF2_BLOCKS * SECTOR_SIZE)
+#define CLUS_UF2_START (CLUS_CRASH_LAST + 1)
+#define CLUS_UF2_LAST (CLUS_UF2_START + (CRASH_UF2_LEN + CLUSTER_SIZE - 1) / CLUSTER_SIZE - 1)
+#define CLUS_AFTER_CRASH (CLUS_UF2_LAST + 1)
+// UF2 extension tags follow the payload (not in the SDK's uf2.h)
+#ifndef UF2_FLAG_EXTENSION_FLAGS_PRESENT
+#define UF2_FLAG_EXTENSION_FLAGS_PRESENT 0x00008000u
+#endif
+// ours: 8 bytes, the type then the capture block's address
+#define CRASH_UF2_TAG (8u | 0xc4a5d0u << 8)
+#else
+#define CLUS_AFTER_CRASH (CLUS_CRASH_LAST + 1)
+#endif
+
+#ifdef USE_CRASH_RING
+// Then CRASH00n.BIN for each flash ring slot that holds a crash
+#define RING_CLUSTERS ((CRASH_RING_FILE_SIZE + CLUSTER_SIZE - 1) / CLUSTER_SIZE)
+#define CLUS_RING_START CLUS_AFTER_CRASH
+#define CLUS_LAST (CLUS_RING_START + CRASH_RING_SLOTS * RING_CLUSTERS - 1)
+#else
+#define CLUS_LAST (CLUS_AFTER_CRASH - 1)
+#endif
+
 static_assert(CLUSTER_COUNT <= 65526, "FAT16 limit");
 
 #ifdef NO_PARTITION_TABLE
@@ -69,10 +167,34 @@ static_assert(VOLUME_SIZE >= 16 * 1024 * 1024, "volume too small for fat16");
 #define MAX_RAM_UF2_BLOCKS 1280
 static_assert(MAX_RAM_UF2_BLOCKS >= ((SRAM_END - SRAM_BASE) + (XIP_SRAM_END - XIP_SRAM_BASE)) / 256, "");
 
+#ifndef USE_LIVE_EXPORT
 extern __noinline __attribute__((noreturn)) void reset_usb_boot(
     uint32_t _usb_activity_gpio_pin_mask, uint32_t disable_interface_mask);
+#else
+// there is no bootrom to hand over to, but vd_write_block ignores UF2 blocks
+#define reset_usb_boot(_usb_activity_gpio_pin_mask, disable_interface_mask) __builtin_unreachable()
+#endif
 
 static __attribute__((aligned(4))) uint32_t uf2_valid_ram_blocks[(MAX_RAM_UF2_BLOCKS + 31) / 32];
+#ifdef USE_AUTO_RESUME
+static uint _crash_sectors_read;
+#endif
+
+#ifdef USE_VD_CACHE
+// The sectors up to REGS.TXT (partition table, boot sector, FATs, root
+// directory, INDEX.HTM, INFO_UF2.TXT and REGS.TXT) don't change while we are
+// up, and hosts read the first few of them over and over while mounting. The
+// last VD_CACHE_SECTORS of them read are kept in the XIP overlay, shared with
+// the UF2 bitmaps (so a UF2 block flushes the cache), with the tags in USB RAM.
+#define VD_CACHE_LBA_END \
+    (SECTOR_COUNT - VOLUME_SECTOR_COUNT + 1 + SECTORS_PER_FAT * FAT_COUNT + ROOT_DIRECTORY_SECTORS + \
+     ((CLUS_REGS + 1 - FIRST_CLUSTER) << CLUSTER_SHIFT))
+
+struct vd_cache_stats vd_cache_stats;
+// lba + 1 (0 for none) and the slot in xip_overlay->vd_cache, most recently used first
+static uint32_t _vd_cache_lba[VD_CACHE_SECTORS];
+static uint8_t _vd_cache_slot[VD_CACHE_SECTORS];
+#endif
 
 enum partition_type {
     PT_FAT12 = 1,
@@ -174,6 +296,11 @@ static struct uf2_info {
     uint32_t block_no;
     struct async_task next_task;
     bool ram;
+#ifdef USE_CRASH_UF2
+    // CRASHDMP.UF2 coming back: the capture block's address from its tag
+    bool replay;
+    uint32_t replay_block;
+#endif
 } _uf2_info;
 
 // --- start non IRQ code ---
@@ -181,6 +308,13 @@ static struct uf2_info {
 static void _write_uf2_page_complete(struct async_task *task) {
     if (task->token == _uf2_info.token) {
         if (!task->result && _uf2_info.valid_block_count == _uf2_info.num_blocks) {
+#ifdef USE_CRASH_UF2
+            // back into dump mode, with SRAM as it was in the crash
+            if (_uf2_info.replay) {
+                crashdump_replay(_uf2_info.replay_block);
+                safe_reboot(0, SRAM_END, 1000);
+            } else
+#endif
             safe_reboot(_uf2_info.ram ? _uf2_info.lowest_addr : 0, SRAM_END, 1000); //300); // reboot in 300 ms
         }
     }
@@ -189,7 +323,17 @@ static void _write_uf2_page_complete(struct async_task *task) {
 
 // return true for async
 static bool _write_uf2_page() {
-    reset_usb_boot(usb_activity_gpio_pin_mask, 0);
+#ifdef USE_CRASH_UF2
+    // CRASHDMP.UF2 is for us rather than the real bootrom
+    if (!_uf2_info.replay)
+#endif
+    {
+#ifdef USE_BOOTROM_GPIO
+        reset_usb_boot(usb_activity_gpio_pin_mask, 0);
+#else
+        reset_usb_boot(0, 0);
+#endif
+    }
     // If we need to write a page (i.e. it hasn't been written before, then we queue a task to do that asynchronously
     //
     // Note that in an ideal world, given that we aren't synchronizing with the task in any way from here on,
@@ -209,7 +353,7 @@ static bool _write_uf2_page() {
     // the task just takes an immutable command (with possibly mutable data), and takes care of writing that data to FLASH or RAM
     // along with erase etc.
     usb_debug("_write_uf2_page tok %d block %d / %d\n", (int) _uf2_info.token, _uf2_info.block_no,
-              (int) _uf2_info.info.num_blocks);
+              (int) _uf2_info.num_blocks);
     uint block_offset = _uf2_info.block_no / 32;
     uint32_t block_mask = 1u << (_uf2_info.block_no & 31u);
     if (!(_uf2_info.valid_blocks[block_offset] & block_mask)) {
@@ -263,8 +407,61 @@ static bool _write_uf2_page() {
 }
 
 void vd_init() {
+#ifdef USE_AUTO_RESUME
+    memset0(xip_arena->vd_coverage, sizeof(xip_arena->vd_coverage));
+    _crash_sectors_read = 0;
+#endif
+#ifdef USE_MINIDUMP
+    minidump_init();
+#endif
+    vd_overlay_flush();
 }
 
+void vd_overlay_flush() {
+#ifdef USE_VD_CACHE
+    vd_cache_flush();
+#endif
+#ifdef USE_BACKTRACE
+    backtrace_flush();
+#endif
+#ifdef USE_SRAM_USAGE
+    sram_usage_flush();
+#endif
+#ifdef USE_TRACE
+    trace_flush();
+#endif
+}
+
+#ifdef USE_VD_CACHE
+void vd_cache_flush() {
+    for (uint i = 0; i < VD_CACHE_SECTORS; i++) {
+        _vd_cache_lba[i] = 0;
+        _vd_cache_slot[i] = i;
+    }
+}
+#endif
+
+void vd_eject() {
+#ifdef USE_AUTO_RESUME
+    crashdump_resume(AUTO_RESUME_DELAY_MS);
+#endif
+}
+
+#ifdef USE_AUTO_RESUME
+// Once the host has read every sector of CRASHDMP.XXD (in any order, as often
+// as it likes), it has what it came for: go back to the application
+static void _crash_sector_read(uint sector) {
+    uint32_t *coverage = xip_arena->vd_coverage;
+    uint32_t mask = 1u << (sector & 31u);
+    if (!(coverage[sector / 32] & mask)) {
+        coverage[sector / 32] |= mask;
+        if (++_crash_sectors_read == CRASH_SECTORS) {
+            crashdump_resume(AUTO_RESUME_DELAY_MS);
+        }
+    }
+}
+#endif
+
 void vd_reset() {
     usb_debug("Resetting virtual disk\n");
     _uf2_info.num_blocks = 0; // marker that uf2_info is invalid
@@ -282,6 +479,25 @@ void hex(uint8_t *buf, const uint32_t word, const uint8_t nibbles) {
     }
 }
 
+#ifdef USE_CRASHDUMP_REGIONS
+// The application's sensitive regions show as "--" (core1 renders too, but the
+// list doesn't change after crashdump_regions_init)
+static void _xxd_redact(uint8_t *buf, uint32_t start) {
+    const struct crashdump_sensitive *sensitive = &xip_arena->crashdump_sensitive;
+    uint32_t end = start + BYTES_DUMPED_PER_SECTOR;
+    for (uint i = 0; i < sensitive->count; i++) {
+        uint32_t from = MAX(sensitive->range[i].start, start), to = MIN(sensitive->range[i].end, end);
+        for (uint32_t addr = from; addr < to; addr++) {
+            uint offset = addr - start, b = offset % 16;
+            uint8_t *line = buf + 64 * (offset / 16);
+            line[0x06 + 5 * (b / 2) + 2 * (b & 1)] = '-';
+            line[0x07 + 5 * (b / 2) + 2 * (b & 1)] = '-';
+            line[0x2f + b] = '-';
+        }
+    }
+}
+#endif
+
 /// Format is
 ///
 ///      addr   0 1  2 3  4 5  6 7  8 9  a b  c d  e f     ascii dump   newline
@@ -293,11 +509,13 @@ void hex(uint8_t *buf, const uint32_t word, const uint8_t nibbles) {
 /// To  make it easier, we hexdump SECTOR_SIZE==512 *output characters* at a
 /// time -- this is exactly 8 lines so we don't have to worry about partial
 /// lines.
-void xxd(uint8_t *const buf, const uint8_t *const mem) {
+///
+/// The bytes are read from mem, but shown as at addr (mem may be a copy).
+void xxd(uint8_t *const buf, const uint8_t *const mem, const uint32_t addr) {
     for (uint8_t line = 0; line < 8; ++line) {
         const size_t buf_offset = 64 * line;
         const size_t mem_offset = 16 * line;
-        hex(&buf[buf_offset + 0x00], (uintptr_t)&mem[mem_offset], 5);
+        hex(&buf[buf_offset + 0x00], addr + mem_offset, 5);
         buf[buf_offset + 0x05] = ' ';
         for (uint8_t hword = 0; hword < 8; ++hword) {
             const size_t buf_offset_h = buf_offset + 5 * hword;
@@ -318,6 +536,165 @@ void xxd(uint8_t *const buf, const uint8_t *const mem) {
         }
         buf[buf_offset + 0x3f] = '\n';
     }
+#ifdef USE_CRASHDUMP_REGIONS
+    _xxd_redact(buf, addr);
+#endif
+}
+
+#ifdef USE_CRASH_UF2
+/// One block of CRASHDMP.UF2: 256 bytes of SRAM from block_no * 256 (with
+/// the sensitive regions zeroed), for the RAM UF2 path in
+/// _update_current_uf2_info, and a tag which tells vd_write_block that it is
+/// a replay, and where the capture block is
+static void crash_uf2_block(uint8_t *buf, uint block_no) {
+    struct uf2_block *uf2 = (struct uf2_block *) buf;
+    uint32_t addr = SRAM_BASE + block_no * 256;
+    uf2->magic_start0 = UF2_MAGIC_START0;
+    uf2->magic_start1 = UF2_MAGIC_START1;
+    uf2->flags = UF2_FLAG_FAMILY_ID_PRESENT | UF2_FLAG_EXTENSION_FLAGS_PRESENT;
+    uf2->target_addr = addr;
+    uf2->payload_size = 256;
+    uf2->block_no = block_no;
+    uf2->num_blocks = CRASH_UF2_BLOCKS;
+    uf2->file_size = RP2040_FAMILY_ID;
+    live_export_copy(uf2->data, (const void *) addr, 256);
+#ifdef USE_CRASHDUMP_REGIONS
+    crashdump_redact(uf2->data, addr, 256);
+#endif
+    const struct crashdump_block *block = crashdump_get_block();
+    uint32_t *tag = (uint32_t *) (uf2->data + 256);
+    tag[0] = CRASH_UF2_TAG;
+    tag[1] = (uintptr_t) block;
+    uf2->magic_end = UF2_MAGIC_END;
+}
+
+// A block of CRASHDMP.UF2, by its tag
+static bool crash_uf2_tagged(const struct uf2_block *uf2, uint32_t *block_addr) {
+    const uint32_t *tag = (const uint32_t *) (uf2->data + 256);
+    if (!(uf2->flags & UF2_FLAG_EXTENSION_FLAGS_PRESENT) || tag[0] != CRASH_UF2_TAG) return false;
+    *block_addr = tag[1];
+    return true;
+}
+#endif
+
+#ifdef USE_CRASH_RING
+// Bit n set if ring slot n holds a crash
+static uint crash_ring_valid_slots() {
+    uint valid = 0;
+    for (uint slot = 0; slot < CRASH_RING_SLOTS; slot++) {
+        if (crash_ring_slot(slot)) valid |= 1u << slot;
+    }
+    return valid;
+}
+#endif
+
+// All files are contiguous from cluster 2, and all but MINIDUMP.BIN,
+// TRACE.BIN, CRASHDMP.XXD and the CRASH00n.BIN files are a single cluster.
+// BACKTRAC.TXT has no file without a crash, so no cluster either
+static uint16_t fat_entry(uint cluster, __unused uint ring_valid) {
+    if (cluster < FIRST_CLUSTER) return cluster ? 0xffff : 0xff00u | MEDIA_TYPE;
+#ifdef USE_MINIDUMP
+    if (CLUS_MINIDUMP_START <= cluster && cluster <= CLUS_MINIDUMP_LAST) {
+        uint used = (minidump_size() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+        uint offset = cluster - CLUS_MINIDUMP_START;
+        // the rest of its room is free
+        if (offset >= used) return 0;
+        if (offset < used - 1) return cluster + 1;
+    }
+#endif
+#ifdef USE_BACKTRACE
+    if (cluster == CLUS_BACKTRACE && !backtrace_size()) return 0;
+#endif
+#ifdef USE_TRACE
+    if (CLUS_TRACE_START <= cluster && cluster <= CLUS_TRACE_LAST) {
+        uint used = (trace_size() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+        uint offset = cluster - CLUS_TRACE_START;
+        if (offset >= used) return 0;
+        if (offset < used - 1) return cluster + 1;
+    }
+#endif
+    if (CLUS_CRASH_START <= cluster && cluster < CLUS_CRASH_LAST) return cluster + 1;
+#ifdef USE_CRASH_UF2
+    if (CLUS_UF2_START <= cluster && cluster < CLUS_UF2_LAST) return cluster + 1;
+#endif
+#ifdef USE_CRASH_RING
+    if (CLUS_RING_START <= cluster) {
+        uint slot = 0, offset = cluster - CLUS_RING_START;
+        while (offset >= RING_CLUSTERS) {
+            offset -= RING_CLUSTERS;
+            slot++;
+        }
+        // empty slots have no file, so their clusters are free
+        if (!(ring_valid & (1u << slot))) return 0;
+        if (offset < RING_CLUSTERS - 1) return cluster + 1;
+    }
+#endif
+    return 0xffff;
+}
+
+static const char regs_txt_names[][6] = {
+        "core", "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7", "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc",
+        "xpsr", "msp", "psp", "excret", "state",
+};
+static_assert(count_of(regs_txt_names) <= SECTOR_SIZE / REGS_TXT_LINE, "");
+static_assert(count_of(regs_txt_names) == 1 + offsetof(struct crashdump_regs, state) / 4 + 1, "");
+
+/// One sector per core, each line is
+///
+///      r0     20001234\n
+///
+/// with unused lines (and all the values, if there was no crash) blank.
+static void regs_txt(uint8_t *buf, uint core) {
+    const struct crashdump_block *block = crashdump_get_block();
+    for (uint line = 0; line < SECTOR_SIZE / REGS_TXT_LINE; line++) {
+        uint8_t *p = buf + line * REGS_TXT_LINE;
+        for (uint i = 0; i < REGS_TXT_LINE - 1; i++) p[i] = ' ';
+        p[REGS_TXT_LINE - 1] = '\n';
+        if (line < count_of(regs_txt_names)) {
+            for (uint i = 0; i < 6 && regs_txt_names[line][i]; i++) p[i] = regs_txt_names[line][i];
+            if (!line) {
+                hex(p + 7, core, 8);
+            } else if (block) {
+                hex(p + 7, ((const uint32_t *) &block->core[core])[line - 1], 8);
+            }
+        }
+    }
+}
+
+static const char stats_txt_names[][STATS_TXT_NAME] = {
+        "bss_size", "usb_stack_size", "usb_stack_used", "sram_stack_used", "sram_touched",
+        "xip_arena_size", "uf2_bitmaps_size",
+#ifdef USE_VD_CACHE
+        "vd_cache_hits", "vd_cache_misses",
+#endif
+};
+#define STATS_LEN (count_of(stats_txt_names) * STATS_TXT_LINE)
+static_assert(STATS_LEN <= SECTOR_SIZE, "");
+
+/// How much RAM we use (ram_stats.h), in bytes, and how the metadata cache is
+/// doing; each line is
+///
+///      usb_stack_used         00000180\n
+///
+/// with ffffffff for unknown.
+static void stats_txt(uint8_t *buf) {
+    struct ram_stats ram;
+    ram_stats_get(&ram);
+    const uint32_t values[] = {
+            ram.bss_size, ram.stack_size, ram.stack_used, ram.sram_stack_used, ram.sram_touched,
+            sizeof(xip_arena_t), FLASH_BITMAPS_SIZE,
+#ifdef USE_VD_CACHE
+            vd_cache_stats.hits, vd_cache_stats.misses,
+#endif
+    };
+    static_assert(count_of(values) == count_of(stats_txt_names), "");
+    for (uint line = 0; line < count_of(values); line++) {
+        uint8_t *p = buf + line * STATS_TXT_LINE;
+        for (uint i = 0; i < STATS_TXT_LINE - 1; i++) p[i] = ' ';
+        p[STATS_TXT_LINE - 1] = '\n';
+        for (uint i = 0; i < STATS_TXT_NAME && stats_txt_names[line][i]; i++) p[i] = stats_txt_names[line][i];
+        hex(p + STATS_TXT_NAME + 1, values[line], 8);
+    }
 }
 
 // note caller must pass SECTOR_SIZE buffer
@@ -333,8 +710,7 @@ void init_dir_entry(struct dir_entry *entry, const char *fn, uint cluster, uint
     entry->size = len;
 }
 
-bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_removed_for_space(uint32_t buf_size)) {
-    assert(buf_size >= SECTOR_SIZE);
+static void _vd_render_block(uint32_t lba, uint8_t *buf) {
     memset0(buf, SECTOR_SIZE);
 #ifndef NO_PARTITION_TABLE
     if (!lba) {
@@ -367,7 +743,7 @@ bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_r
 
         uint32_t sn = msc_get_serial_number32();
         memcpy(buf + MBR_OFFSET_SERIAL_NUMBER, &sn, 4);
-        return false;
+        return;
     }
     lba--;
 #endif
@@ -380,30 +756,16 @@ bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_r
         if (lba < SECTORS_PER_FAT * FAT_COUNT) { // FAT region
             // mirror
             while (lba >= SECTORS_PER_FAT) lba -= SECTORS_PER_FAT;
-            size_t index = 0;
             uint16_t *p = (uint16_t *) buf;
-            if (!lba) {
-                p[index++] = 0xff00u | MEDIA_TYPE;
-                p[index++] = 0xffff;
-                p[index++] = 0xffff; // index.htm
-#ifdef USE_INFO_UF2
-                p[index++] = 0xffff;  // info_uf2.txt
+            const uint min_cluster = lba * (SECTOR_SIZE / 2);
+#ifdef USE_CRASH_RING
+            uint ring_valid = crash_ring_valid_slots();
+#else
+            uint ring_valid = 0;
 #endif
+            for (uint i = 0; i < SECTOR_SIZE / 2 && min_cluster + i <= CLUS_LAST; i++) {
+                p[i] = fat_entry(min_cluster + i, ring_valid);
             }
-
-            const size_t min_index = lba * (SECTOR_SIZE / 2);
-            const size_t max_index = min_index + SECTOR_SIZE / 2 - 1;
-            for (size_t clus_crash = MAX(min_index, CLUS_CRASH_START);
-                    clus_crash <= MIN(max_index, CLUS_CRASH_LAST);
-                    ++clus_crash) {
-                // crashdump.xxd -- point to next cluster
-                p[index++] = clus_crash + 1;
-            }
-            // crashdmp.xxd -- patch up last cluster
-            if (index-1 == CLUS_CRASH_LAST) {
-              p[index-1] = 0xffff;
-            }
-
         } else {
             lba -= SECTORS_PER_FAT * FAT_COUNT;
             if (lba < ROOT_DIRECTORY_SECTORS) {
@@ -416,8 +778,42 @@ bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_r
                     init_dir_entry(++entries, "INDEX   HTM", CLUS_INDEX, welcome_html_len);
 #ifdef USE_INFO_UF2
                     init_dir_entry(++entries, "INFO_UF2TXT", CLUS_INFO, info_uf2_txt_len);
+#endif
+                    init_dir_entry(++entries, "REGS    TXT", CLUS_REGS, REGS_LEN);
+                    init_dir_entry(++entries, "STATS   TXT", CLUS_STATS, STATS_LEN);
+#ifdef USE_MINIDUMP
+                    init_dir_entry(++entries, "MINIDUMPBIN", CLUS_MINIDUMP_START, minidump_size());
+#endif
+#ifdef USE_BACKTRACE
+                    if (backtrace_size()) {
+                        init_dir_entry(++entries, "BACKTRACTXT", CLUS_BACKTRACE, backtrace_size());
+                    }
+#endif
+#ifdef USE_SRAM_USAGE
+                    init_dir_entry(++entries, "USAGE   TXT", CLUS_USAGE, sram_usage_size());
+#endif
+#ifdef USE_TRACE
+                    if (trace_size()) {
+                        init_dir_entry(++entries, "TRACE   BIN", CLUS_TRACE_START, trace_size());
+                    }
+#endif
+#ifdef USE_LOG
+                    init_dir_entry(++entries, "LOG     BIN", CLUS_LOG, LOG_SIZE);
 #endif
                     init_dir_entry(++entries, "CRASHDMPXXD", CLUS_CRASH_START, CRASH_LEN);
+#ifdef USE_CRASH_UF2
+                    init_dir_entry(++entries, "CRASHDMPUF2", CLUS_UF2_START, CRASH_UF2_LEN);
+#endif
+#ifdef USE_CRASH_RING
+                    uint ring_valid = crash_ring_valid_slots();
+                    for (uint slot = 0; slot < CRASH_RING_SLOTS; slot++) {
+                        if (ring_valid & (1u << slot)) {
+                            init_dir_entry(++entries, "CRASH000BIN", CLUS_RING_START + slot * RING_CLUSTERS,
+                                           CRASH_RING_FILE_SIZE);
+                            entries->name[7] += slot + 1;
+                        }
+                    }
+#endif
                 }
             } else {
                 lba -= ROOT_DIRECTORY_SECTORS;
@@ -433,6 +829,9 @@ bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_r
                         memcpy(buf + welcome_html_version_offset_2, serial_number_string, 12);
 #endif
                     }
+                    else if (cluster == CLUS_STATS) {
+                        stats_txt(buf);
+                    }
 #ifdef USE_INFO_UF2
                     else if (cluster == CLUS_INFO) {
                         // spec suggests we have this as raw text in the binary, although it doesn't much matter if no CURRENT.UF2 file
@@ -444,23 +843,117 @@ bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_r
 
                 // This can be in cluster offset 0 (!cluster_offset) and
                 // higher, hence not in the above "if" conditional
+                if (cluster == CLUS_REGS && cluster_offset < CRASHDUMP_NUM_CORES) {
+                    regs_txt(buf, cluster_offset);
+                }
+#ifdef USE_MINIDUMP
+                if (CLUS_MINIDUMP_START <= cluster && cluster <= CLUS_MINIDUMP_LAST) {
+                    minidump_read(lba - ((CLUS_MINIDUMP_START - FIRST_CLUSTER) << CLUSTER_SHIFT), buf);
+                }
+#endif
+#ifdef USE_BACKTRACE
+                if (cluster == CLUS_BACKTRACE) {
+                    backtrace_read(cluster_offset, buf);
+                }
+#endif
+#ifdef USE_SRAM_USAGE
+                if (cluster == CLUS_USAGE) {
+                    sram_usage_read(cluster_offset, buf);
+                }
+#endif
+#ifdef USE_TRACE
+                if (CLUS_TRACE_START <= cluster && cluster <= CLUS_TRACE_LAST) {
+                    trace_read(lba - ((CLUS_TRACE_START - FIRST_CLUSTER) << CLUSTER_SHIFT), buf);
+                }
+#endif
+#ifdef USE_LOG
+                if (cluster == CLUS_LOG) {
+                    log_read(cluster_offset, buf);
+                }
+#endif
                 if (CLUS_CRASH_START <= cluster && cluster <= CLUS_CRASH_LAST) {
-                    xxd(buf,
-                            (uint8_t *)SRAM_BASE
-                            + (cluster - CLUS_CRASH_START) * BYTES_DUMPED_PER_CLUSTER
-                            + cluster_offset * BYTES_DUMPED_PER_SECTOR);
+                    uint sector = lba - ((CLUS_CRASH_START - FIRST_CLUSTER) << CLUSTER_SHIFT);
+                    uint32_t addr = SRAM_BASE + sector * BYTES_DUMPED_PER_SECTOR;
+#ifdef USE_LIVE_EXPORT
+                    // the whole sector's worth as at one moment
+                    static uint32_t _snapshot[BYTES_DUMPED_PER_SECTOR / 4];
+                    live_export_copy(_snapshot, (const void *) addr, BYTES_DUMPED_PER_SECTOR);
+                    xxd(buf, (const uint8_t *) _snapshot, addr);
+#else
+#ifdef USE_XXD_RENDER
+                    if (!xxd_render_take(sector, buf))
+#endif
+                    xxd(buf, (const uint8_t *) addr, addr);
+#endif
+#ifdef USE_AUTO_RESUME
+                    _crash_sector_read(sector);
+#endif
                 }
+#ifdef USE_CRASH_UF2
+                if (CLUS_UF2_START <= cluster && cluster <= CLUS_UF2_LAST) {
+                    uint block_no = lba - ((CLUS_UF2_START - FIRST_CLUSTER) << CLUSTER_SHIFT);
+                    if (block_no < CRASH_UF2_BLOCKS) crash_uf2_block(buf, block_no);
+                }
+#endif
+#ifdef USE_CRASH_RING
+                if (CLUS_RING_START <= cluster && cluster <= CLUS_LAST) {
+                    uint slot = 0, sector = lba - ((CLUS_RING_START - FIRST_CLUSTER) << CLUSTER_SHIFT);
+                    while (sector >= RING_CLUSTERS << CLUSTER_SHIFT) {
+                        sector -= RING_CLUSTERS << CLUSTER_SHIFT;
+                        slot++;
+                    }
+                    crash_ring_read(slot, sector, buf);
+                }
+#endif
             }
         }
     }
+}
+
+#ifdef USE_VD_CACHE
+static void _vd_cache_read(uint32_t lba, uint8_t *buf) {
+    uint i = 0;
+    while (i < VD_CACHE_SECTORS - 1 && _vd_cache_lba[i] != lba + 1) i++;
+    uint8_t slot = _vd_cache_slot[i];
+    uint8_t *data = xip_overlay->vd_cache[slot];
+    if (_vd_cache_lba[i] == lba + 1) {
+        vd_cache_stats.hits++;
+        memcpy(buf, data, SECTOR_SIZE);
+    } else {
+        // i is the least recently used
+        vd_cache_stats.misses++;
+        _vd_render_block(lba, buf);
+        memcpy(data, buf, SECTOR_SIZE);
+    }
+    for (; i; i--) {
+        _vd_cache_lba[i] = _vd_cache_lba[i - 1];
+        _vd_cache_slot[i] = _vd_cache_slot[i - 1];
+    }
+    _vd_cache_lba[0] = lba + 1;
+    _vd_cache_slot[0] = slot;
+}
+#endif
+
+bool vd_read_block(__unused uint32_t token, uint32_t lba, uint8_t *buf __comma_removed_for_space(uint32_t buf_size)) {
+    assert(buf_size >= SECTOR_SIZE);
+#ifdef USE_VD_CACHE
+    if (lba < VD_CACHE_LBA_END) {
+        _vd_cache_read(lba, buf);
+        return false;
+    }
+#endif
+    _vd_render_block(lba, buf);
     return false;
 }
 
 #define FLASH_MAX_VALID_BLOCKS ((FLASH_BITMAPS_SIZE * 8LL * FLASH_SECTOR_ERASE_SIZE / (FLASH_PAGE_SIZE + FLASH_SECTOR_ERASE_SIZE)) & ~31u)
-#define FLASH_CLEARED_PAGES_BASE (FLASH_VALID_BLOCKS_BASE + FLASH_MAX_VALID_BLOCKS / 8)
-static_assert(!(FLASH_CLEARED_PAGES_BASE & 0x3), "");
+static_assert(FLASH_MAX_VALID_BLOCKS * FLASH_PAGE_SIZE >= 16u << 20, "UF2 bitmaps don't cover all of flash");
+#define FLASH_CLEARED_PAGES_OFFSET (FLASH_MAX_VALID_BLOCKS / 8)
+// (as offsets, as the base is only known at link time with USE_LIVE_EXPORT)
+static_assert(!(FLASH_CLEARED_PAGES_OFFSET & 0x3), "");
+#define FLASH_CLEARED_PAGES_BASE (FLASH_VALID_BLOCKS_BASE + FLASH_CLEARED_PAGES_OFFSET)
 #define FLASH_MAX_CLEARED_PAGES (FLASH_MAX_VALID_BLOCKS * FLASH_PAGE_SIZE / FLASH_SECTOR_ERASE_SIZE)
-static_assert(FLASH_CLEARED_PAGES_BASE + (FLASH_MAX_CLEARED_PAGES / 32 - FLASH_VALID_BLOCKS_BASE <= FLASH_BITMAPS_SIZE),
+static_assert(FLASH_CLEARED_PAGES_OFFSET + FLASH_MAX_CLEARED_PAGES / 8 <= FLASH_BITMAPS_SIZE,
               "");
 
 static void _clear_bitset(uint32_t *mask, uint32_t count) {
@@ -535,12 +1028,22 @@ static bool _update_current_uf2_info(struct uf2_block *uf2, uint32_t token) {
 
 // note caller must pass SECTOR_SIZE buffer
 bool vd_write_block(uint32_t token, __unused uint32_t lba, uint8_t *buf __comma_removed_for_space(uint32_t buf_size)) {
+#ifdef USE_LIVE_EXPORT
+    // nothing to download into (live_export.h)
+    uf2_debug("Sector %d: ignoring write to live export\n", (uint) lba);
+    return false;
+#endif
     struct uf2_block *uf2 = (struct uf2_block *) buf;
     if (uf2->magic_start0 == UF2_MAGIC_START0 && uf2->magic_start1 == UF2_MAGIC_START1 &&
         uf2->magic_end == UF2_MAGIC_END) {
         if (uf2->flags & UF2_FLAG_FAMILY_ID_PRESENT && uf2->file_size == RP2040_FAMILY_ID &&
             !(uf2->flags & UF2_FLAG_NOT_MAIN_FLASH) && uf2->payload_size == 256) {
+            // the UF2 bitmaps are about to be used
+            vd_overlay_flush();
             if (_update_current_uf2_info(uf2, token)) {
+#ifdef USE_CRASH_UF2
+                _uf2_info.replay = _uf2_info.ram && crash_uf2_tagged(uf2, &_uf2_info.replay_block);
+#endif
                 // if we have a valid uf2 page, write it
                 return _write_uf2_page();
             }
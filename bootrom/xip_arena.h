@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _XIP_ARENA_H
+#define _XIP_ARENA_H
+
+#include "runtime.h"
+#include "async_task.h"
+#include "xxd_render.h"
+#include "minidump.h"
+#include "backtrace.h"
+#include "sram_usage.h"
+#include "trace.h"
+#include "log.h"
+#include "gdb_stub.h"
+#include "virtual_disk.h"
+
+// _usb_boot turns the XIP cache off, leaving its 16K of SRAM for the flash
+// workspace: the UF2 bitmaps from FLASH_VALID_BLOCKS_BASE up, and at the top
+// this arena, for anything else that needs more memory than the 3K of USB RAM
+// (.bss and the stack) can spare, and mustn't touch the SRAM being dumped.
+//
+// It is allocated at compile time: each user is a member of xip_arena_t, so
+// the compiler bumps and aligns, and the bitmaps get what is left
+// (FLASH_BITMAPS_SIZE), which virtual_disk.c checks still covers all of flash.
+// Nothing here is initialized; each user sets up its own part.
+//
+// Users that are never live during a UF2 download (which hands over to the
+// real bootrom anyway) overlay the bitmaps instead (xip_overlay_t), flushing
+// themselves when a UF2 block arrives, or any PICOBOOT command but a read
+// (vd_overlay_flush). The crash ring's .xip_ram_* sections overlay the lot, but are never used in USB
+// mode.
+
+typedef struct {
+#ifdef USE_XXD_RENDER
+    // core1's ring of pre-rendered CRASHDMP.XXD sectors, and its stack
+    struct xxd_render_ring xxd_render;
+#endif
+#ifdef USE_AUTO_RESUME
+    // which sectors of CRASHDMP.XXD the host has read, a bit each
+    uint32_t vd_coverage[512 / 4];
+#endif
+#ifdef USE_MINIDUMP
+    // MINIDUMP.BIN's header and region descriptors
+    struct minidump_layout minidump;
+#endif
+#ifdef USE_CRASHDUMP_REGIONS
+    // the application's sensitive regions (crashdump.c)
+    struct crashdump_sensitive crashdump_sensitive;
+#endif
+#ifdef USE_LOG
+    // the deferred log, which is not flushed but started by _usb_boot, and
+    // written to when the UF2 bitmaps are cleared
+    struct log_ring log;
+#endif
+#ifdef USE_PICOBOOT_DUMP
+    // the PICOBOOT dump's chunk buffer, only ever holding the sector being
+    // sent, which MSC may write a UF2 block over in the meantime
+    uint8_t picoboot_dump[MINIDUMP_SECTOR_SIZE];
+#endif
+#ifdef USE_GDB_STUB
+    // the gdb stub's parser, reply and read buffer
+    struct gdb_stub gdb_stub;
+#endif
+    // so the struct is never empty
+    uint32_t _end[0];
+} xip_arena_t;
+
+#define XIP_ARENA_BASE (FLASH_VALID_BLOCKS_BASE + FLASH_WORKSPACE_SIZE - sizeof(xip_arena_t))
+#define xip_arena ((xip_arena_t *) XIP_ARENA_BASE)
+
+#define FLASH_BITMAPS_SIZE (FLASH_WORKSPACE_SIZE - sizeof(xip_arena_t))
+static_assert(!(sizeof(xip_arena_t) & 3u), "");
+
+typedef struct {
+#ifdef USE_VD_CACHE
+    // virtual_disk.c's metadata cache
+    uint8_t vd_cache[VD_CACHE_SECTORS][SECTOR_SIZE];
+#endif
+#ifdef USE_BACKTRACE
+    // BACKTRACE.TXT's lines, once scanned
+    struct backtrace backtrace;
+#endif
+#ifdef USE_SRAM_USAGE
+    // USAGE.TXT's ranges and estimates, once scanned
+    struct sram_usage sram_usage;
+#endif
+#ifdef USE_TRACE
+    // where TRACE.BIN's sectors start in the application's trace rings
+    struct trace_index trace;
+#endif
+    uint32_t _end[0];
+} xip_overlay_t;
+
+#define xip_overlay ((xip_overlay_t *) FLASH_VALID_BLOCKS_BASE)
+static_assert(sizeof(xip_overlay_t) <= FLASH_BITMAPS_SIZE, "");
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "xxd_render.h"
+#include "xip_arena.h"
+#include "hardware/regs/m0plus.h"
+#include "hardware/structs/psm.h"
+#include "hardware/structs/sio.h"
+#include "hardware/sync.h"
+
+#define ring (&xip_arena->xxd_render)
+
+// in USB RAM, so cleared by _usb_boot whether or not we start
+static bool xxd_render_running;
+
+static void __attribute__((noreturn)) xxd_render_core1() {
+    while (true) {
+        uint32_t next = ring->next;
+        bool rendered = false;
+        for (uint32_t sector = next; sector < next + XXD_RENDER_SLOTS && sector < XXD_RENDER_SECTORS; sector++) {
+            uint slot = sector & (XXD_RENDER_SLOTS - 1);
+            if (ring->sector[slot] != sector) {
+                ring->sector[slot] = XXD_RENDER_NONE;
+                __dmb();
+                uint32_t addr = SRAM_BASE + sector * XXD_RENDER_BYTES_PER_SECTOR;
+                xxd(ring->buf[slot], (const uint8_t *) addr, addr);
+                __dmb();
+                ring->sector[slot] = sector;
+                rendered = true;
+                break;
+            }
+        }
+        // until the host reads on
+        if (!rendered) __wfe();
+    }
+}
+
+static void _fifo_drain() {
+    while (sio_hw->fifo_st & SIO_FIFO_ST_VLD_BITS) (void) sio_hw->fifo_rd;
+}
+
+static uint32_t _fifo_push_pop(uint32_t word) {
+    while (!(sio_hw->fifo_st & SIO_FIFO_ST_RDY_BITS));
+    sio_hw->fifo_wr = word;
+    __sev();
+    while (!(sio_hw->fifo_st & SIO_FIFO_ST_VLD_BITS)) __wfe();
+    return sio_hw->fifo_rd;
+}
+
+static void _core1_reset() {
+    hw_set_bits(&psm_hw->frce_off, PSM_FRCE_OFF_PROC1_BITS);
+    while (!(psm_hw->frce_off & PSM_FRCE_OFF_PROC1_BITS));
+}
+
+void xxd_render_start() {
+    ring->next = 0;
+    for (uint slot = 0; slot < XXD_RENDER_SLOTS; slot++) ring->sector[slot] = XXD_RENDER_NONE;
+    // core1 may still be where the crash froze it: reset it into the ROM's
+    // wait for the launch sequence (as the SDK's multicore_launch_core1)
+    _core1_reset();
+    hw_clear_bits(&psm_hw->frce_off, PSM_FRCE_OFF_PROC1_BITS);
+    const uint32_t cmds[] = {
+            0, 0, 1,
+            *(io_rw_32 *) (PPB_BASE + M0PLUS_VTOR_OFFSET),
+            (uintptr_t) (ring->stack + XXD_RENDER_STACK_WORDS),
+            (uintptr_t) xxd_render_core1,
+    };
+    uint i = 0;
+    do {
+        // a zero resynchronizes core1, which may have something in the FIFO
+        if (!cmds[i]) {
+            _fifo_drain();
+            __sev();
+        }
+        i = _fifo_push_pop(cmds[i]) == cmds[i] ? i + 1 : 0;
+    } while (i < count_of(cmds));
+    xxd_render_running = true;
+}
+
+void xxd_render_stop() {
+    uint32_t save = save_and_disable_interrupts();
+    if (xxd_render_running) {
+        xxd_render_running = false;
+        _core1_reset();
+    }
+    restore_interrupts(save);
+}
+
+bool xxd_render_take(uint32_t sector, uint8_t *buf) {
+    if (!xxd_render_running) return false;
+    uint slot = sector & (XXD_RENDER_SLOTS - 1);
+    bool hit = ring->sector[slot] == sector;
+    if (hit) {
+        __dmb();
+        memcpy(buf, ring->buf[slot], SECTOR_SIZE);
+        __dmb();
+        // core1 may have moved on to a later sector while we copied
+        hit = ring->sector[slot] == sector;
+    }
+    ring->next = sector + 1;
+    __sev();
+    return hit;
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _XXD_RENDER_H
+#define _XXD_RENDER_H
+
+#include "runtime.h"
+#include "usb_boot_device.h"
+#include "usb_msc.h"
+
+// Core1 has nothing to do in dump mode, so it renders the CRASHDMP.XXD
+// sectors just after the one the host last read (hosts copy files front to
+// back) into a small ring, and vd_read_block only has to copy them out. On a
+// miss, vd_read_block renders the sector itself as before.
+//
+// The ring lives in the XIP arena (xip_arena.h), with core1's stack. Each
+// slot has a tag, which core1 clears before rendering into the slot and sets
+// after; core0 reads the tag again after copying, so needs no lock.
+
+#define XXD_RENDER_SLOTS 4
+static_assert(!(XXD_RENDER_SLOTS & (XXD_RENDER_SLOTS - 1)), "");
+#define XXD_RENDER_NONE 0xffffffffu
+#define XXD_RENDER_STACK_WORDS 64
+// CRASHDMP.XXD is 4 characters per byte of SRAM
+#define XXD_RENDER_BYTES_PER_SECTOR (SECTOR_SIZE / 4)
+#define XXD_RENDER_SECTORS ((SRAM_END - SRAM_BASE) / XXD_RENDER_BYTES_PER_SECTOR)
+
+struct xxd_render_ring {
+    // the sector the host will want next, set by core0
+    volatile uint32_t next;
+    // which sector of CRASHDMP.XXD each slot holds, or XXD_RENDER_NONE
+    volatile uint32_t sector[XXD_RENDER_SLOTS];
+    uint8_t buf[XXD_RENDER_SLOTS][SECTOR_SIZE];
+    uint32_t stack[XXD_RENDER_STACK_WORDS];
+};
+
+// One sector of CRASHDMP.XXD, of the SRAM at addr as read from mem
+// (virtual_disk.c)
+void xxd(uint8_t *buf, const uint8_t *mem, uint32_t addr);
+
+// Start core1 rendering
+void xxd_render_start(void);
+
+// Stop core1 for good, as SRAM or flash is about to change (core1 runs from
+// flash, and would go on serving SRAM as it was)
+void xxd_render_stop(void);
+
+// Copy sector of CRASHDMP.XXD into buf if core1 has it ready, and have core1
+// render the ones after it. False on a miss
+bool xxd_render_take(uint32_t sector, uint8_t *buf);
+
+#endif
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRASH_CAPTURE_H
+#define _CRASH_CAPTURE_H
+
+#include "crashdump.h"
+
+// Provided by the crashdump_capture library, which also takes over
+// isr_hardfault and isr_nmi: any HardFault captures the faulting core's
+// registers into crashdump_block, freezes the other core (capturing its
+// registers too) and reboots into the crash dump image.
+
+extern struct crashdump_block crashdump_block;
+
+// Capture the calling core's registers (as at this call) and enter the crash
+// dump image. Suitable as PICO_PANIC_FUNCTION.
+void __attribute__((noreturn)) crashdump_trigger(void);
+
+// Tell the crash dump image about a variable: what it is called, how much it
+// matters for MINIDUMP.BIN (lower priority goes first), and flags
+// (CRASHDUMP_REGION_SENSITIVE never to show it, CRASHDUMP_REGION_SKIP to leave
+// it out of MINIDUMP.BIN), e.g.
+//
+//      CRASHDUMP_REGION(log_ring, "log", 0, 0);
+//      CRASHDUMP_REGION(session_key, "key", 0, CRASHDUMP_REGION_SENSITIVE);
+//
+// The descriptors go into the crashdump_regions section in flash, which the
+// capture library points the crash dump image at.
+#define CRASHDUMP_REGION(var, name, priority, flags) \
+    CRASHDUMP_REGION_RANGE(var, &(var), sizeof(var), name, priority, flags)
+
+// As CRASHDUMP_REGION, for any range of memory; id just has to be unique
+#define CRASHDUMP_REGION_RANGE(id, addr, size, name, priority, flags) \
+    static const struct crashdump_region __attribute__((section("crashdump_regions"), used, aligned(4))) \
+    __crashdump_region_##id = {(uintptr_t) (addr), (size), (priority), (flags), 0, name}
+
+// Ask the crash dump image to save crashes into its flash ring and restart the
+// application through the vector table at vtor (e.g. ppb_hw->vtor as set up by
+// crt0), instead of waiting for a USB host. NULL turns it off again. As
+// crashdump_block is not initialized, call this on every boot.
+static inline void crashdump_persist(const void *vtor) {
+    crashdump_block.resume_vector = (uintptr_t) vtor;
+}
+
+#endif
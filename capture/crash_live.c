@@ -0,0 +1,23 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "pico/multicore.h"
+#include "crash_live.h"
+
+// live_export.h, which is the image's side and doesn't mix with the SDK's
+// headers
+void __attribute__((noreturn)) live_export_core1(uint dma_channel);
+
+static uint crash_live_dma_channel;
+
+static void crash_live_core1(void) {
+    live_export_core1(crash_live_dma_channel);
+}
+
+void crashdump_live_start(uint dma_channel) {
+    crash_live_dma_channel = dma_channel;
+    multicore_launch_core1(crash_live_core1);
+}
@@ -0,0 +1,29 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRASH_LIVE_H
+#define _CRASH_LIVE_H
+
+#include "pico/types.h"
+
+// Provided by the crashdump_live library: the crash dump image's USB device
+// (the disk, with CRASHDMP.XXD and MINIDUMP.BIN, and PICOBOOT) run by core1
+// inside the application, serving its memory as it is while core0 goes on.
+// Each sector is DMA-copied out of SRAM in one go, so is consistent with
+// itself, but sectors read at different times are not with each other.
+//
+// Read only: UF2 downloads are ignored, and PICOBOOT only reads (flash through
+// XIP, leaving the cache alone). CRASHDUMP_REGIONs are served and redacted as
+// after a crash; REGS.TXT is blank.
+//
+// The library takes core1, the USB controller (so no stdio_usb or TinyUSB),
+// the USBCTRL_IRQ handler and 16K of RAM for its workspace.
+
+// Launch core1 into the USB device; dma_channel (e.g. from
+// dma_claim_unused_channel) is its for good
+void crashdump_live_start(uint dma_channel);
+
+#endif
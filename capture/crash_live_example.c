@@ -0,0 +1,25 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The least an application does to serve its memory with crashdump_live (and
+// crash into the image with crashdump_capture); built along with the image, so
+// the libraries' links are checked
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "crash_capture.h"
+#include "crash_live.h"
+
+static uint32_t counter;
+CRASHDUMP_REGION(counter, "counter", 0, 0);
+
+int main(void) {
+    crashdump_live_start(dma_claim_unused_channel(true));
+    while (true) {
+        counter++;
+        sleep_ms(100);
+    }
+}
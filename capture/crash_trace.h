@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CRASH_TRACE_H
+#define _CRASH_TRACE_H
+
+#include "hardware/structs/sio.h"
+#include "hardware/structs/timer.h"
+#include "hardware/sync.h"
+#include "trace.h"
+
+// A trace of the last CRASH_TRACE_EVENTS events on each core before a crash,
+// which the crash dump image shows as TRACE.BIN (host/trace decodes it).
+// Header only: call crash_trace_init() on every boot, before any
+// crash_trace(), e.g.
+//
+//      crash_trace(EVENT_USB_SETUP, setup->wValue);
+//
+// Each core writes its own ring, so there is no lock, just interrupts off
+// for the few cycles of a write (an event is the time, a 16 bit id and an
+// argument).
+
+#ifndef CRASH_TRACE_EVENTS
+#define CRASH_TRACE_EVENTS 1024
+#endif
+static_assert(!(CRASH_TRACE_EVENTS & (CRASH_TRACE_EVENTS - 1)), "");
+
+struct crash_trace_ring {
+    struct trace_ring_header header;
+    struct trace_event event[CRASH_TRACE_EVENTS];
+};
+
+// weak, so that each file including this agrees on the one copy
+__attribute__((weak, section(".uninitialized_data.crash_trace")))
+struct crash_trace_ring crash_trace_rings[2];
+
+static inline void crash_trace_init(void) {
+    for (uint core = 0; core < 2; core++) {
+        struct trace_ring_header *header = &crash_trace_rings[core].header;
+        header->self = (uintptr_t) header;
+        header->core = core;
+        header->events = CRASH_TRACE_EVENTS;
+        header->count = 0;
+        // last, so the crash dump image never finds half a header
+        __dmb();
+        header->magic = TRACE_MAGIC;
+    }
+}
+
+static inline void crash_trace(uint16_t id, uint32_t arg) {
+    struct crash_trace_ring *ring = &crash_trace_rings[sio_hw->cpuid];
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t n = ring->header.count;
+    struct trace_event *event = &ring->event[n & (CRASH_TRACE_EVENTS - 1)];
+    event->time = timer_hw->timerawl;
+    event->id = id;
+    event->arg = arg;
+    ring->header.count = n + 1;
+    restore_interrupts(save);
+}
+
+#endif
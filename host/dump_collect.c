@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Collect a crash straight off the device's PICOBOOT interface, for rigs that
+// would rather not mount the drive: one PC_CRASHDUMP_DUMP for the whole stream
+// (bootrom/minidump.h), written out as an ELF core for gdb, and optionally as
+// it came (which minidump can read too).
+//
+//      dump_collect /dev/bus/usb/BUS/DEV core.elf [--save dump.bin]
+//
+// Through usbfs, so with no libraries, but it needs write access to the
+// device node.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/usbdevice_fs.h>
+
+#include "minidump_decode.h"
+#include "boot/picoboot.h"
+
+// The boot device's PICOBOOT interface, after mass storage
+#define PICOBOOT_INTERFACE 1
+#define PICOBOOT_EP_OUT 0x03
+#define PICOBOOT_EP_IN 0x84
+#define REQUEST_OUT_VENDOR_INTERFACE 0x41
+
+// usbfs's default limit on a single transfer
+#define BULK_MAX (16 * 1024)
+#define TIMEOUT_MS 5000
+
+static void usage(void) {
+    fprintf(stderr, "usage: dump_collect DEVICE CORE [--save FILE]\n");
+    exit(2);
+}
+
+static int bulk(int fd, unsigned int ep, void *data, unsigned int len) {
+    struct usbdevfs_bulktransfer bulk = {.ep = ep, .len = len, .timeout = TIMEOUT_MS, .data = data};
+    return ioctl(fd, USBDEVFS_BULK, &bulk);
+}
+
+// The command, its data and the ack (an empty OUT, as it is an IN command)
+static bool collect(int fd, uint8_t *dump) {
+    unsigned int interface = PICOBOOT_INTERFACE;
+    if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &interface)) return false;
+    // in case an earlier command was left half done
+    struct usbdevfs_ctrltransfer reset = {
+            .bRequestType = REQUEST_OUT_VENDOR_INTERFACE,
+            .bRequest = PICOBOOT_IF_RESET,
+            .wIndex = PICOBOOT_INTERFACE,
+            .timeout = TIMEOUT_MS,
+    };
+    if (ioctl(fd, USBDEVFS_CONTROL, &reset) < 0) return false;
+    struct picoboot_cmd cmd = {
+            .dMagic = PICOBOOT_MAGIC,
+            .dToken = 1,
+            .bCmdId = PC_CRASHDUMP_DUMP,
+            .bCmdSize = sizeof(struct picoboot_range_cmd),
+            .dTransferLength = MINIDUMP_DUMP_SIZE,
+            .range_cmd = {0, MINIDUMP_DUMP_SIZE},
+    };
+    if (bulk(fd, PICOBOOT_EP_OUT, &cmd, sizeof(cmd)) != sizeof(cmd)) return false;
+    for (uint32_t done = 0; done < MINIDUMP_DUMP_SIZE;) {
+        unsigned int len = MINIDUMP_DUMP_SIZE - done < BULK_MAX ? MINIDUMP_DUMP_SIZE - done : BULK_MAX;
+        int n = bulk(fd, PICOBOOT_EP_IN, dump + done, len);
+        if (n <= 0) return false;
+        done += n;
+    }
+    return bulk(fd, PICOBOOT_EP_OUT, NULL, 0) == 0 && !ioctl(fd, USBDEVFS_RELEASEINTERFACE, &interface);
+}
+
+static bool write_file(const char *path, const uint8_t *data, size_t len) {
+    FILE *f = fopen(path, "wb");
+    return f && fwrite(data, 1, len, f) == len && !fclose(f);
+}
+
+int main(int argc, char **argv) {
+    const char *save_path = NULL;
+    if (argc == 5 && !strcmp(argv[3], "--save")) {
+        save_path = argv[4];
+    } else if (argc != 3) {
+        usage();
+    }
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    static uint8_t dump[MINIDUMP_DUMP_SIZE];
+    if (!collect(fd, dump)) {
+        perror(argv[1]);
+        return 1;
+    }
+    close(fd);
+    if (save_path && !write_file(save_path, dump, sizeof(dump))) {
+        perror(save_path);
+        return 1;
+    }
+    const char *error = minidump_check(dump, sizeof(dump));
+    if (error) {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+    FILE *f = fopen(argv[2], "wb");
+    if (!f || !minidump_to_core(f, dump) || fclose(f)) {
+        perror(argv[2]);
+        return 1;
+    }
+    minidump_print(stdout, dump);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The image's gdb stub on a Linux host, from a RAM snapshot: the USB side runs
+// against the simulated controller (usb_sim.c), and the stub's CDC-ACM data
+// endpoints are bridged to a pseudo terminal, which gdb connects to as it
+// would to /dev/ttyACM0.
+//
+//      gdb_sim --ram sram.bin [--flash flash.bin] [--block ADDR] [--link PATH]
+//
+// e.g. gdb_sim --ram sram.bin --block 0x20000400 --link /tmp/crash &
+//      arm-none-eabi-gdb app.elf -ex 'target remote /tmp/crash'
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "vd_host.h"
+#include "usb_sim.h"
+
+// (usb_sim.h has the addresses)
+#define SRAM_SIZE (264u * 1024u)
+#define FLASH_SIZE (16u << 20)
+
+static void usage(void) {
+    fprintf(stderr, "usage: gdb_sim --ram FILE [--flash FILE] [--block ADDR] [--link PATH]\n");
+    exit(2);
+}
+
+// The master side of a new pseudo terminal, in raw mode; the slave is left
+// open, so that the master doesn't see a hang up between gdb sessions
+static int open_pty(const char **slave_name) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) || unlockpt(fd)) return -1;
+    *slave_name = ptsname(fd);
+    int slave = open(*slave_name, O_RDWR | O_NOCTTY);
+    if (slave < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(slave, &tio)) return -1;
+    cfmakeraw(&tio);
+    if (tcsetattr(slave, TCSANOW, &tio)) return -1;
+    return fd;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Whatever the host writes goes to the stub a packet at a time, and whatever
+// the stub has for the host once it has dealt with each
+static int bridge(int fd) {
+    for (;;) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, -1) < 0) return -1;
+        uint8_t buf[64];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) return -1;
+        if (usb_sim_bulk_out(USB_SIM_GDB_OUT, buf, n) < 0) return -1;
+        uint8_t reply[1024];
+        int len;
+        do {
+            len = usb_sim_bulk_in_poll(USB_SIM_GDB_IN, reply, sizeof(reply));
+            if (len < 0 || !write_all(fd, reply, len)) return -1;
+        } while (len == sizeof(reply));
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *ram = NULL, *flash = NULL, *link_path = NULL;
+    uint32_t block = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) usage();
+        if (!strcmp(argv[i], "--ram")) ram = argv[++i];
+        else if (!strcmp(argv[i], "--flash")) flash = argv[++i];
+        else if (!strcmp(argv[i], "--block")) block = strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--link")) link_path = argv[++i];
+        else usage();
+    }
+    if (!ram) usage();
+
+    if (!vd_host_map()) {
+        perror("mapping target memory");
+        return 1;
+    }
+    if (vd_host_load(ram, SRAM_BASE, SRAM_SIZE) < 0) {
+        perror(ram);
+        return 1;
+    }
+    if (flash && vd_host_load(flash, XIP_NOCACHE_NOALLOC_BASE, FLASH_SIZE) < 0) {
+        perror(flash);
+        return 1;
+    }
+    if (block) vd_host_set_crash(block);
+
+    usb_sim_connect();
+    if (!usb_sim_enumerate(1)) {
+        fprintf(stderr, "gdb_sim: enumeration failed\n");
+        return 1;
+    }
+
+    const char *slave_name;
+    int fd = open_pty(&slave_name);
+    if (fd < 0) {
+        perror("pty");
+        return 1;
+    }
+    if (link_path) {
+        unlink(link_path);
+        if (symlink(slave_name, link_path)) {
+            perror(link_path);
+            return 1;
+        }
+    }
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    if (bridge(fd)) {
+        perror("gdb_sim");
+        return 1;
+    }
+    return 0;
+}
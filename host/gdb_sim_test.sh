@@ -0,0 +1,19 @@
+#!/bin/sh
+# gdb_sim_test.sh GDB GDB_SIM: gdb, with no ELF (so going by the stub's target
+# description), reading SRAM through gdb_sim
+set -e
+gdb=$1
+gdb_sim=$2
+dir=$(mktemp -d)
+trap 'kill $pid 2>/dev/null; rm -rf "$dir"' EXIT
+printf 'Hello, crash!\n' >"$dir/sram.bin"
+"$gdb_sim" --ram "$dir/sram.bin" --link "$dir/tty" >"$dir/pty" &
+pid=$!
+# gdb_sim prints the pty once it is up
+for i in $(seq 50); do
+    [ -s "$dir/pty" ] && break
+    sleep 0.1
+done
+out=$("$gdb" -nx -batch -ex "target remote $dir/tty" -ex 'x/s 0x20000000' -ex 'info threads' 2>&1)
+echo "$out"
+echo "$out" | grep -q 'Hello, crash!'
@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// What the device code needs from the rest of the image and from the chip,
+// for running it on a Linux host: shared by the virtual disk port and usb_sim
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "runtime.h"
+#include "crashdump.h"
+#include "usb_boot_device.h"
+#include "virtual_disk.h"
+#include "ram_stats.h"
+#include "hardware/regs/sysinfo.h"
+#include "hardware/structs/usb.h"
+#include "hardware/structs/watchdog.h"
+#include "vd_host.h"
+
+struct vd_host_events vd_host_events;
+jmp_buf *vd_host_usb_boot_jmp;
+
+uint32_t usb_activity_gpio_pin_mask;
+
+static const struct {
+    uint32_t addr;
+    uint32_t size;
+    uint8_t fill;
+} vd_host_regions[] = {
+        {SRAM_BASE,                SRAM_END - SRAM_BASE,         0},
+        // erased flash
+        {XIP_NOCACHE_NOALLOC_BASE, 16u << 20,                    0xff},
+        {XIP_SRAM_BASE,            XIP_SRAM_END - XIP_SRAM_BASE, 0},
+        {SYSINFO_BASE,             4096,                         0},
+        {TIMER_BASE,               4096,                         0},
+        {WATCHDOG_BASE,            4096,                         0},
+        // the USB controller: DPRAM, then the registers and their xor/set/clear aliases
+        {USBCTRL_DPRAM_BASE,       USB_DPRAM_SIZE,               0},
+        {USBCTRL_REGS_BASE,        4 * 4096,                     0},
+        {SIO_BASE,                 4096,                         0},
+};
+
+bool vd_host_map() {
+    for (uint i = 0; i < count_of(vd_host_regions); i++) {
+        void *p = mmap((void *) (uintptr_t) vd_host_regions[i].addr, vd_host_regions[i].size,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (p != (void *) (uintptr_t) vd_host_regions[i].addr) {
+            if (p != MAP_FAILED) errno = EEXIST; // older kernels ignore MAP_FIXED_NOREPLACE
+            return false;
+        }
+        if (vd_host_regions[i].fill) memset(p, vd_host_regions[i].fill, vd_host_regions[i].size);
+    }
+    // a made up chip revision, for the USB serial number
+    *(uint32_t *) (SYSINFO_BASE + SYSINFO_GITREF_RP2040_OFFSET) = 0x0c0ffee0;
+#ifdef USE_LOG
+    // as _usb_boot
+    log_init();
+#endif
+    return true;
+}
+
+long vd_host_load(const char *path, uint32_t addr, uint32_t max) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t n = fread((void *) (uintptr_t) addr, 1, max, f);
+    bool error = ferror(f);
+    fclose(f);
+    return error ? -1 : (long) n;
+}
+
+void vd_host_set_crash(uint32_t block_addr) {
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_MAGIC;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_BLOCK] = block_addr;
+#ifdef USE_CRASHDUMP_REGIONS
+    crashdump_regions_init();
+#endif
+}
+
+uint32_t vd_host_sector_count() {
+    return vd_sector_count();
+}
+
+// A UF2 download hands over to the real bootrom; here it ends whatever the
+// host was doing
+void __attribute__((noreturn)) reset_usb_boot(__unused uint32_t gpio_pin_mask, __unused uint32_t disable_interface_mask) {
+    vd_host_events.usb_boots++;
+    longjmp(*vd_host_usb_boot_jmp, 1);
+}
+
+void watchdog_reboot(__unused uint32_t pc, __unused uint32_t sp, uint32_t delay_ms) {
+    vd_host_events.reboots++;
+    vd_host_events.reboot_delay_ms = delay_ms;
+    vd_host_events.reboot_pending = true;
+}
+
+void watchdog_reboot_cancel() {
+    vd_host_events.reboot_pending = false;
+}
+
+bool watchdog_rebooting() {
+    return vd_host_events.reboot_pending;
+}
+
+// Nothing to measure on the host: the image's RAM use is the device's
+void ram_stats_get(struct ram_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->stack_size = USB_BOOT_STACK_SIZE * 4;
+    stats->sram_touched = RAM_STATS_UNKNOWN;
+}
+
+void *__memcpy(void *dest, const void *src, uint n) {
+    return memmove(dest, src, n);
+}
+
+void memset0(void *dest, uint n) {
+    memset(dest, 0, n);
+}
+
+// As bootrom_misc.S
+uint32_t crc32_small(const uint8_t *buf, unsigned int len, uint32_t seed) {
+    while (len--) {
+        uint32_t t = (uint32_t) (*buf++ ^ (seed >> 24)) << 24;
+        for (int i = 0; i < 8; i++) t = (t << 1) ^ (t & 0x80000000u ? 0x04c11db7u : 0);
+        seed = (seed << 8) ^ t;
+    }
+    return seed;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <string.h>
+
+#include "log_decode.h"
+
+const char *log_check(const uint8_t *file, size_t size) {
+    const struct log_ring *ring = (const struct log_ring *) file;
+    if (size < offsetof(struct log_ring, word)) return "too short";
+    if (ring->magic != LOG_MAGIC) return "bad magic (was the log started?)";
+    if (ring->version != LOG_VERSION) return "unknown version";
+    if (!ring->words || (ring->words & (ring->words - 1)) ||
+        size < offsetof(struct log_ring, word) + ring->words * sizeof(uint32_t)) {
+        return "bad size";
+    }
+    if (ring->head - ring->tail > ring->words) return "bad head or tail";
+    return NULL;
+}
+
+static const char *_string(const struct log_decode_image *image, uint32_t addr) {
+    if (!image->data || addr < image->addr || addr - image->addr >= image->size) return NULL;
+    const char *s = (const char *) image->data + (addr - image->addr);
+    return memchr(s, 0, image->size - (addr - image->addr)) ? s : NULL;
+}
+
+// printf, but with each argument a 32 bit word
+static void _format(FILE *f, const char *format, const uint32_t *arg, unsigned int args,
+                    const struct log_decode_image *image) {
+    unsigned int n = 0;
+    while (*format) {
+        if (*format != '%') {
+            fputc(*format++, f);
+            continue;
+        }
+        // flags, width and precision as they are, less any length
+        char spec[32] = "%";
+        size_t len = 1;
+        const char *p = format + 1;
+        while (*p && strchr("-+ #0123456789.", *p) && len < sizeof(spec) - 2) spec[len++] = *p++;
+        while (*p && strchr("hlzjt", *p)) p++;
+        char conversion = *p ? *p++ : '%';
+        format = p;
+        if (conversion == '%') {
+            fputc('%', f);
+            continue;
+        }
+        if (n >= args) {
+            fputs("<?>", f);
+            continue;
+        }
+        uint32_t word = arg[n++];
+        const char *s;
+        switch (conversion) {
+            case 's':
+                s = _string(image, word);
+                if (s) {
+                    spec[len++] = 's';
+                    fprintf(f, spec, s);
+                } else {
+                    fprintf(f, "<%08x>", word);
+                }
+                break;
+            case 'p':
+                fprintf(f, "0x%08x", word);
+                break;
+            case 'd':
+            case 'i':
+            case 'c':
+                spec[len++] = conversion;
+                fprintf(f, spec, (int) word);
+                break;
+            default:
+                spec[len++] = strchr("uxXo", conversion) ? conversion : 'x';
+                fprintf(f, spec, (unsigned int) word);
+        }
+    }
+}
+
+unsigned int log_print(FILE *f, const uint8_t *file, const struct log_decode_image *image) {
+    const struct log_ring *ring = (const struct log_ring *) file;
+    uint32_t mask = ring->words - 1;
+    unsigned int entries = 0;
+    bool line_start = true;
+    for (uint32_t n = ring->tail; n != ring->head; entries++) {
+        uint32_t header = ring->word[n & mask];
+        uint32_t id = header & LOG_ENTRY_ID_BITS;
+        unsigned int args = LOG_ENTRY_ARGS(header);
+        if (args > LOG_MAX_ARGS || LOG_ENTRY_LEVEL(header) > LOG_PRINT || id >= image->formats_size ||
+            !memchr(image->formats + id, 0, image->formats_size - id) ||
+            ring->head - n < LOG_ENTRY_WORDS(header)) {
+            fprintf(f, "(entry %u makes no sense: the log moved on while it was read)\n", entries);
+            break;
+        }
+        uint32_t word[2 + LOG_MAX_ARGS];
+        for (unsigned int i = 0; i < LOG_ENTRY_WORDS(header); i++) word[i] = ring->word[(n + i) & mask];
+        if (line_start) fprintf(f, "%10u ", word[1]);
+        if (LOG_ENTRY_LEVEL(header) == LOG_WARN) fputs("WARNING: ", f);
+        const char *format = image->formats + id;
+        _format(f, format, word + 2, args, image);
+        line_start = *format && format[strlen(format) - 1] == '\n';
+        n += LOG_ENTRY_WORDS(header);
+    }
+    if (!line_start) fputc('\n', f);
+    return entries;
+}
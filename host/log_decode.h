@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _LOG_DECODE_H
+#define _LOG_DECODE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "log.h"
+
+// Reading LOG.BIN (bootrom/log.h) on a PC
+
+// The formats (the image's log_fmt section, i.e. bootrom.logfmt), and
+// optionally the image itself, for %s
+struct log_decode_image {
+    const char *formats;
+    size_t formats_size;
+    const uint8_t *data;
+    uint32_t addr;
+    size_t size;
+};
+
+// NULL if file (of size bytes) is a log we can read, what is wrong with it
+// otherwise
+const char *log_check(const uint8_t *file, size_t size);
+
+// Print a checked file's entries, oldest first, each line starting with the
+// time (us) its first entry was logged. Stops early at an entry that makes no
+// sense (the ring moved on while the host read it); the number printed
+unsigned int log_print(FILE *f, const uint8_t *file, const struct log_decode_image *image);
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Print a LOG.BIN, formatted with the formats the build dumped from the
+// image (bootrom.logfmt), and with --bin the image itself (from XIP_BASE),
+// so that %s arguments show as the strings rather than their addresses.
+//
+//      logdump LOG.BIN bootrom.logfmt [--bin bootrom.bin]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_decode.h"
+
+static uint8_t *read_all(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 64 * 1024;
+    uint8_t *data = malloc(cap);
+    *size = 0;
+    size_t n;
+    while (data && (n = fread(data + *size, 1, cap - *size, f)) > 0) {
+        *size += n;
+        if (*size == cap) data = realloc(data, cap *= 2);
+    }
+    if (ferror(f)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    if (!(argc == 3 || (argc == 5 && !strcmp(argv[3], "--bin")))) {
+        fprintf(stderr, "usage: logdump LOG.BIN bootrom.logfmt [--bin bootrom.bin]\n");
+        return 2;
+    }
+    struct log_decode_image image = {.addr = XIP_BASE};
+    size_t size;
+    uint8_t *file = read_all(argv[1], &size);
+    image.formats = (const char *) read_all(argv[2], &image.formats_size);
+    if (argc == 5) image.data = read_all(argv[4], &image.size);
+    const char *missing = !file ? argv[1] : !image.formats ? argv[2] : argc == 5 && !image.data ? argv[4] : NULL;
+    if (missing) {
+        perror(missing);
+        return 1;
+    }
+    const char *error = log_check(file, size);
+    if (error) {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+    const struct log_ring *ring = (const struct log_ring *) file;
+    if (ring->lost) printf("(%u older entries lost)\n", ring->lost);
+    log_print(stdout, file, &image);
+    return 0;
+}
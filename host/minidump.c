@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Print what is in a MINIDUMP.BIN (or a PICOBOOT dump, see dump_collect), and
+// optionally turn it into an SRAM image (zeroes where the minidump has
+// nothing) for vd_host or a debugger, or an ELF core for gdb.
+//
+//      minidump MINIDUMP.BIN [--sram sram.bin] [--core core.elf]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minidump_decode.h"
+
+static uint8_t *read_all(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 64 * 1024;
+    uint8_t *data = malloc(cap);
+    *size = 0;
+    size_t n;
+    while (data && (n = fread(data + *size, 1, cap - *size, f)) > 0) {
+        *size += n;
+        if (*size == cap) data = realloc(data, cap *= 2);
+    }
+    if (ferror(f)) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    const char *sram_path = NULL, *core_path = NULL;
+    bool ok = argc >= 2 && argc % 2 == 0;
+    for (int i = 2; ok && i < argc; i += 2) {
+        if (!strcmp(argv[i], "--sram")) sram_path = argv[i + 1];
+        else if (!strcmp(argv[i], "--core")) core_path = argv[i + 1];
+        else ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "usage: minidump MINIDUMP.BIN [--sram FILE] [--core FILE]\n");
+        return 2;
+    }
+    size_t size;
+    uint8_t *file = read_all(argv[1], &size);
+    if (!file) {
+        perror(argv[1]);
+        return 1;
+    }
+    const char *error = minidump_check(file, size);
+    if (error) {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 1;
+    }
+    minidump_print(stdout, file);
+
+    if (sram_path) {
+        static uint8_t sram[SRAM_END - SRAM_BASE];
+        uint32_t block = minidump_to_sram(file, sram);
+        FILE *f = fopen(sram_path, "wb");
+        if (!f || fwrite(sram, 1, sizeof(sram), f) != sizeof(sram) || fclose(f)) {
+            perror(sram_path);
+            return 1;
+        }
+        if (block) printf("capture block at 0x%08x (vd_host --block)\n", block);
+    }
+    if (core_path) {
+        FILE *f = fopen(core_path, "wb");
+        if (!f || !minidump_to_core(f, file) || fclose(f)) {
+            perror(core_path);
+            return 1;
+        }
+    }
+    free(file);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <elf.h>
+#include <signal.h>
+#include <string.h>
+
+#include "minidump_decode.h"
+
+static const struct minidump_header *header(const uint8_t *file) {
+    return (const struct minidump_header *) file;
+}
+
+const struct minidump_region *minidump_region(const uint8_t *file, unsigned int i) {
+    return (const struct minidump_region *) (file + header(file)->header_size + i * header(file)->region_size);
+}
+
+const char *minidump_check(const uint8_t *file, size_t size) {
+    if (size < sizeof(struct minidump_header) || header(file)->magic != MINIDUMP_MAGIC) return "not a minidump";
+    const struct minidump_header *h = header(file);
+    // later versions may only add fields
+    if (h->version < 1 || h->header_size < sizeof(struct minidump_header) ||
+        h->region_size < MINIDUMP_REGION_V1_SIZE) {
+        return "unknown version";
+    }
+    if (h->size != size) return "wrong size";
+    if (h->header_size + (size_t) h->region_count * h->region_size > size) return "truncated descriptors";
+    for (unsigned int i = 0; i < h->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        if ((size_t) r->offset + r->size > size) return "region outside the file";
+        if (r->type == MINIDUMP_REGION_BLOCK && r->size < CRASHDUMP_BLOCK_MIN_SIZE) return "short capture block";
+    }
+    return NULL;
+}
+
+static const char *region_type(const struct minidump_region *r) {
+    switch (r->type) {
+        case MINIDUMP_REGION_BLOCK:
+            return "block";
+        case MINIDUMP_REGION_STACK:
+            return r->flags & MINIDUMP_FLAG_PSP ? "psp" : "msp";
+        case MINIDUMP_REGION_APP:
+            return "app";
+        case MINIDUMP_REGION_SRAM:
+            return "sram";
+        default:
+            return "?";
+    }
+}
+
+static void print_regs(FILE *f, const struct crashdump_block *block) {
+    static const char *const states[] = {"not captured", "faulted", "frozen"};
+    for (unsigned int core = 0; core < CRASHDUMP_NUM_CORES; core++) {
+        const struct crashdump_regs *regs = &block->core[core];
+        fprintf(f, "core %u: %s\n", core, regs->state < 3 ? states[regs->state] : "?");
+        if (regs->state == CRASHDUMP_STATE_NONE) continue;
+        for (unsigned int i = 0; i < 16; i++) {
+            static const char *const names[] = {"r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+                                                "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc"};
+            fprintf(f, "  %-4s %08x%s", names[i], regs->r[i], i % 4 == 3 ? "\n" : "");
+        }
+        fprintf(f, "  xpsr %08x  msp  %08x  psp  %08x  exc_return %08x\n", regs->xpsr, regs->msp, regs->psp,
+                regs->exc_return);
+    }
+}
+
+void minidump_print(FILE *f, const uint8_t *file) {
+    const struct minidump_header *h = header(file);
+    fprintf(f, "minidump version %u, %u regions, %u bytes\n", h->version, h->region_count, h->size);
+    const struct crashdump_block *block = NULL;
+    for (unsigned int i = 0; i < h->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        fprintf(f, "  %-5s core %u  %08x..%08x  %6u bytes%s", region_type(r), r->core, r->addr, r->addr + r->size,
+                r->size, r->flags & MINIDUMP_FLAG_TRUNCATED ? " (truncated)" : "");
+        // from version 2
+        if (r->type == MINIDUMP_REGION_APP && h->region_size >= sizeof(struct minidump_region)) {
+            fprintf(f, "  %.*s", (int) sizeof(r->name), r->name);
+        }
+        fprintf(f, "\n");
+        if (r->type == MINIDUMP_REGION_BLOCK) block = (const struct crashdump_block *) (file + r->offset);
+    }
+    if (block) {
+        fprintf(f, "crashed core %u\n", block->crashed_core);
+        print_regs(f, block);
+    }
+}
+
+uint32_t minidump_to_sram(const uint8_t *file, uint8_t *sram) {
+    uint32_t block_addr = 0;
+    for (unsigned int i = 0; i < header(file)->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        if (r->addr < SRAM_BASE || r->addr > SRAM_END || r->size > SRAM_END - r->addr) continue;
+        memcpy(sram + (r->addr - SRAM_BASE), file + r->offset, r->size);
+        if (r->type == MINIDUMP_REGION_BLOCK) block_addr = r->addr;
+    }
+    return block_addr;
+}
+
+// struct elf_prstatus as 32 bit ARM Linux lays it out, which is what gdb reads
+struct arm_prstatus {
+    int32_t si_signo, si_code, si_errno;
+    int16_t cursig;
+    uint16_t _pad;
+    uint32_t sigpend, sighold;
+    int32_t pid, ppid, pgrp, sid;
+    uint32_t times[8];
+    // r0-r15, cpsr, orig_r0
+    uint32_t reg[18];
+    int32_t fpvalid;
+};
+_Static_assert(sizeof(struct arm_prstatus) == 148, "");
+
+struct prstatus_note {
+    Elf32_Nhdr nhdr;
+    char name[8];
+    struct arm_prstatus prstatus;
+};
+
+static bool inside_another(const uint8_t *file, unsigned int i) {
+    const struct minidump_region *r = minidump_region(file, i);
+    for (unsigned int j = 0; j < header(file)->region_count; j++) {
+        const struct minidump_region *o = minidump_region(file, j);
+        if (j == i || r->addr < o->addr || r->addr + r->size > o->addr + o->size) continue;
+        // of two the same, the first stays
+        if (r->addr != o->addr || r->size != o->size || j < i) return true;
+    }
+    return false;
+}
+
+bool minidump_to_core(FILE *f, const uint8_t *file) {
+    const struct minidump_header *h = header(file);
+    const struct crashdump_block *block = NULL;
+    unsigned int loads = 0;
+    for (unsigned int i = 0; i < h->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        if (r->type == MINIDUMP_REGION_BLOCK) block = (const struct crashdump_block *) (file + r->offset);
+        if (!inside_another(file, i)) loads++;
+    }
+
+    // a thread per captured core, the crashed one first (gdb's current thread)
+    struct prstatus_note notes[CRASHDUMP_NUM_CORES];
+    unsigned int threads = 0;
+    for (unsigned int n = 0; block && n < CRASHDUMP_NUM_CORES; n++) {
+        unsigned int core = (block->crashed_core + n) % CRASHDUMP_NUM_CORES;
+        const struct crashdump_regs *regs = &block->core[core];
+        if (regs->state == CRASHDUMP_STATE_NONE) continue;
+        struct prstatus_note *note = &notes[threads++];
+        memset(note, 0, sizeof(*note));
+        note->nhdr = (Elf32_Nhdr) {sizeof("CORE"), sizeof(struct arm_prstatus), NT_PRSTATUS};
+        memcpy(note->name, "CORE", sizeof("CORE"));
+        note->prstatus.si_signo = note->prstatus.cursig = regs->state == CRASHDUMP_STATE_FAULTED ? SIGSEGV : 0;
+        note->prstatus.pid = core + 1;
+        memcpy(note->prstatus.reg, regs->r, sizeof(regs->r));
+        note->prstatus.reg[16] = regs->xpsr;
+    }
+
+    Elf32_Ehdr ehdr = {
+            .e_ident = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS32, ELFDATA2LSB, EV_CURRENT},
+            .e_type = ET_CORE,
+            .e_machine = EM_ARM,
+            .e_version = EV_CURRENT,
+            .e_phoff = sizeof(Elf32_Ehdr),
+            .e_ehsize = sizeof(Elf32_Ehdr),
+            .e_phentsize = sizeof(Elf32_Phdr),
+            .e_phnum = 1 + loads,
+    };
+    uint32_t offset = sizeof(Elf32_Ehdr) + ehdr.e_phnum * sizeof(Elf32_Phdr);
+    Elf32_Phdr note_phdr = {
+            .p_type = PT_NOTE,
+            .p_offset = offset,
+            .p_filesz = threads * sizeof(struct prstatus_note),
+            .p_align = 4,
+    };
+    bool ok = fwrite(&ehdr, sizeof(ehdr), 1, f) && fwrite(&note_phdr, sizeof(note_phdr), 1, f);
+    offset += note_phdr.p_filesz;
+    for (unsigned int i = 0; i < h->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        if (inside_another(file, i)) continue;
+        Elf32_Phdr phdr = {
+                .p_type = PT_LOAD,
+                .p_offset = offset,
+                .p_vaddr = r->addr,
+                .p_paddr = r->addr,
+                .p_filesz = r->size,
+                .p_memsz = r->size,
+                .p_flags = PF_R | PF_W,
+                .p_align = 4,
+        };
+        ok = ok && fwrite(&phdr, sizeof(phdr), 1, f);
+        offset += (r->size + 3) & ~3u;
+    }
+    ok = ok && fwrite(notes, sizeof(notes[0]), threads, f) == threads;
+    for (unsigned int i = 0; i < h->region_count; i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        if (inside_another(file, i)) continue;
+        static const uint8_t pad[3];
+        ok = ok && fwrite(file + r->offset, 1, r->size, f) == r->size &&
+             fwrite(pad, 1, -r->size & 3u, f) == (-r->size & 3u);
+    }
+    return ok;
+}
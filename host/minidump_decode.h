@@ -0,0 +1,37 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MINIDUMP_DECODE_H
+#define _MINIDUMP_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "minidump.h"
+
+// Reading MINIDUMP.BIN (bootrom/minidump.h) on a PC
+
+// NULL if file (of size bytes) is a minidump we can read, what is wrong with
+// it otherwise
+const char *minidump_check(const uint8_t *file, size_t size);
+
+// The i'th region of a checked file
+const struct minidump_region *minidump_region(const uint8_t *file, unsigned int i);
+
+// The regions, and the registers from the capture block
+void minidump_print(FILE *f, const uint8_t *file);
+
+// Copy the regions into sram, an image of SRAM_BASE..SRAM_END (e.g. for
+// vd_host --ram); the capture block's address, or 0 if there is none
+uint32_t minidump_to_sram(const uint8_t *file, uint8_t *sram);
+
+// Write a checked file to f as a 32 bit ARM ELF core, for gdb: a PT_LOAD for
+// each region (but those inside another), and an NT_PRSTATUS for each
+// captured core, the crashed one first. false if writing failed
+bool minidump_to_core(FILE *f, const uint8_t *file);
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_REGS_ADDRESSMAP_H
+#define _HARDWARE_REGS_ADDRESSMAP_H
+
+// The RP2040 addresses the host port uses; host_runtime.c maps memory at the
+// ones it needs, so the device code can use them as they are
+
+#define ROM_BASE                 0x00000000u
+#define XIP_BASE                 0x10000000u
+#define XIP_MAIN_BASE            0x10000000u
+#define XIP_NOALLOC_BASE         0x11000000u
+#define XIP_NOCACHE_BASE         0x12000000u
+#define XIP_NOCACHE_NOALLOC_BASE 0x13000000u
+#define XIP_SRAM_BASE            0x15000000u
+#define XIP_SRAM_END             0x15004000u
+#define SRAM_BASE                0x20000000u
+#define SRAM_END                 0x20042000u
+#define SYSINFO_BASE             0x40000000u
+#define TIMER_BASE               0x40054000u
+#define WATCHDOG_BASE            0x40058000u
+#define USBCTRL_DPRAM_BASE       0x50100000u
+#define USBCTRL_REGS_BASE        0x50110000u
+#define SIO_BASE                 0xd0000000u
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_REGS_INTCTRL_H
+#define _HARDWARE_REGS_INTCTRL_H
+
+#define USBCTRL_IRQ 5
+
+#endif
@@ -0,0 +1,12 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_REGS_SYSINFO_H
+#define _HARDWARE_REGS_SYSINFO_H
+
+#define SYSINFO_GITREF_RP2040_OFFSET 0x40
+
+#endif
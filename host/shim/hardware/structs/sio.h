@@ -0,0 +1,17 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_STRUCTS_SIO_H
+#define _HARDWARE_STRUCTS_SIO_H
+
+#include "pico.h"
+
+// only for runtime.h's gpio_*_mask (the USB activity LED, none on the host)
+#define SIO_GPIO_OUT_SET_OFFSET 0x14
+#define SIO_GPIO_OUT_CLR_OFFSET 0x18
+#define SIO_GPIO_OUT_XOR_OFFSET 0x1c
+
+#endif
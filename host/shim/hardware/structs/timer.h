@@ -0,0 +1,19 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_STRUCTS_TIMER_H
+#define _HARDWARE_STRUCTS_TIMER_H
+
+#include "pico.h"
+
+typedef struct {
+    volatile uint32_t _pad[10];
+    volatile uint32_t timerawl;
+} timer_hw_t;
+
+#define timer_hw ((timer_hw_t *) TIMER_BASE)
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_STRUCTS_USB_H
+#define _HARDWARE_STRUCTS_USB_H
+
+#include "pico.h"
+#include "hardware/address_mapped.h"
+
+// The RP2040 USB controller's registers and DPRAM, as the SDK lays them out,
+// with the bits usb_device_tiny uses. usb_sim maps both and plays the host
+
+#define USB_NUM_ENDPOINTS 16
+#define USB_DPRAM_SIZE 4096u
+#define USB_DPRAM_MAX USB_DPRAM_SIZE
+#define USB_DEVICE_DPRAM_MAX USB_DPRAM_MAX
+
+typedef struct {
+    io_rw_32 dev_addr_ctrl;
+    io_rw_32 int_ep_addr_ctrl[USB_NUM_ENDPOINTS - 1];
+    io_rw_32 main_ctrl;
+    io_rw_32 sof_rw;
+    io_ro_32 sof_rd;
+    io_rw_32 sie_ctrl;
+    io_rw_32 sie_status;
+    io_rw_32 int_ep_ctrl;
+    io_rw_32 buf_status;
+    io_ro_32 buf_cpu_should_handle;
+    io_rw_32 abort;
+    io_rw_32 abort_done;
+    io_rw_32 ep_stall_arm;
+    io_rw_32 nak_poll;
+    io_rw_32 ep_nak_stall_status;
+    io_rw_32 muxing;
+    io_rw_32 pwr;
+    io_rw_32 phy_direct;
+    io_rw_32 phy_direct_override;
+    io_rw_32 phy_trim;
+    uint32_t _pad0;
+    io_ro_32 intr;
+    io_rw_32 inte;
+    io_rw_32 intf;
+    io_ro_32 ints;
+} usb_hw_t;
+
+check_hw_layout(usb_hw_t, main_ctrl, 0x40);
+check_hw_layout(usb_hw_t, buf_status, 0x58);
+check_hw_layout(usb_hw_t, ints, 0x98);
+
+struct usb_device_dpram {
+    volatile uint8_t setup_packet[8];
+    struct usb_device_dpram_ep_ctrl {
+        io_rw_32 in;
+        io_rw_32 out;
+    } ep_ctrl[USB_NUM_ENDPOINTS - 1];
+    struct usb_device_dpram_ep_buf_ctrl {
+        io_rw_32 in;
+        io_rw_32 out;
+    } ep_buf_ctrl[USB_NUM_ENDPOINTS];
+    uint8_t ep0_buf_a[0x40];
+    uint8_t ep0_buf_b[0x40];
+    uint8_t epx_data[USB_DPRAM_MAX - 0x180];
+};
+
+check_hw_layout(struct usb_device_dpram, ep_buf_ctrl, 0x80);
+check_hw_layout(struct usb_device_dpram, ep0_buf_a, 0x100);
+
+#define usb_hw ((usb_hw_t *) USBCTRL_REGS_BASE)
+#define usb_dpram ((struct usb_device_dpram *) USBCTRL_DPRAM_BASE)
+
+#define USB_MAIN_CTRL_CONTROLLER_EN_BITS 0x00000001u
+
+#define USB_SIE_CTRL_PULLUP_EN_BITS 0x00010000u
+#define USB_SIE_CTRL_EP0_INT_1BUF_BITS 0x20000000u
+
+#define USB_SIE_STATUS_SETUP_REC_BITS 0x00020000u
+#define USB_SIE_STATUS_BUS_RESET_BITS 0x00080000u
+#define USB_SIE_STATUS_DATA_SEQ_ERROR_BITS 0x80000000u
+
+#define USB_EP_STALL_ARM_EP0_IN_BITS 0x00000001u
+#define USB_EP_STALL_ARM_EP0_OUT_BITS 0x00000002u
+
+#define USB_USB_MUXING_TO_PHY_BITS 0x00000001u
+#define USB_USB_MUXING_SOFTCON_BITS 0x00000008u
+
+#define USB_USB_PWR_VBUS_DETECT_BITS 0x00000004u
+#define USB_USB_PWR_VBUS_DETECT_OVERRIDE_EN_BITS 0x00000008u
+
+#define USB_INTS_BUFF_STATUS_BITS 0x00000010u
+#define USB_INTS_ERROR_DATA_SEQ_BITS 0x00000020u
+#define USB_INTS_ERROR_RX_TIMEOUT_BITS 0x00000040u
+#define USB_INTS_ERROR_RX_OVERFLOW_BITS 0x00000080u
+#define USB_INTS_ERROR_BIT_STUFF_BITS 0x00000100u
+#define USB_INTS_ERROR_CRC_BITS 0x00000200u
+#define USB_INTS_BUS_RESET_BITS 0x00001000u
+#define USB_INTS_SETUP_REQ_BITS 0x00010000u
+#define USB_INTS_EP_STALL_NAK_BITS 0x00080000u
+
+// one half of an ep_buf_ctrl register (buffer 1 is the top half)
+#define USB_BUF_CTRL_FULL      0x00008000u
+#define USB_BUF_CTRL_LAST      0x00004000u
+#define USB_BUF_CTRL_LAST_BUF  USB_BUF_CTRL_LAST
+#define USB_BUF_CTRL_DATA0_PID 0x00000000u
+#define USB_BUF_CTRL_DATA1_PID 0x00002000u
+#define USB_BUF_CTRL_SEL       0x00001000u
+#define USB_BUF_CTRL_BUFF_SEL  USB_BUF_CTRL_SEL
+#define USB_BUF_CTRL_STALL     0x00000800u
+#define USB_BUF_CTRL_AVAIL     0x00000400u
+#define USB_BUF_CTRL_LEN_MASK  0x000003ffu
+
+#define EP_CTRL_ENABLE_BITS (1u << 31u)
+#define EP_CTRL_DOUBLE_BUFFERED_BITS (1u << 30u)
+#define EP_CTRL_INTERRUPT_PER_BUFFER (1u << 29u)
+#define EP_CTRL_INTERRUPT_PER_DOUBLE_BUFFER (1u << 28u)
+#define EP_CTRL_INTERRUPT_ON_STALL (1u << 17u)
+#define EP_CTRL_INTERRUPT_ON_NAK (1u << 16u)
+#define EP_CTRL_BUFFER_TYPE_LSB 26u
+#define EP_CTRL_BUFFER_ADDRESS_BITS 0x0000ffffu
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico.h"
+
+// On the host the USB interrupt and the task worker never run at the same
+// time (usb_sim calls them in turn), so there is nothing to mask
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(__unused uint32_t status) {
+}
+
+static inline void __mem_fence_acquire(void) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
+static inline void __sev(void) {
+}
+
+// usb_sim's: the worker has nothing left to do, so back to the host
+void __wfe(void);
+
+#endif
@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PICO_H
+#define _PICO_H
+
+// Host stand-in for the SDK's pico.h, with just what the virtual disk and USB
+// code use
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "pico/types.h"
+#include "hardware/regs/addressmap.h"
+
+#define __noinline __attribute__((noinline))
+#define __unused __attribute__((unused))
+#define __used __attribute__((used))
+#define __aligned(x) __attribute__((aligned(x)))
+#define __packed __attribute__((packed))
+#define __force_inline inline __attribute__((always_inline))
+#define __isr
+#define __breakpoint() __builtin_trap()
+#define __wfi() ((void)0)
+#define remove_volatile_cast(t, x) ({__atomic_thread_fence(__ATOMIC_ACQUIRE); (t)(x); })
+
+static inline bool running_on_fpga() {
+    return false;
+}
+
+#endif
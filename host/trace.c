@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Print a TRACE.BIN, one event a line: time (us), the time since the event
+// before, core, the event's number on its core, id and argument. With
+// --ids, ids are shown by name, from lines of "<id> <name>" (the id in C
+// syntax, so 0x.. is hex).
+//
+//      trace TRACE.BIN [--ids ids.txt]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define MAX_IDS 65536
+
+static char *names[MAX_IDS];
+
+static int read_ids(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        unsigned long id = strtoul(line, &end, 0);
+        if (end == line || id >= MAX_IDS) continue;
+        end += strspn(end, " \t");
+        end[strcspn(end, "\r\n")] = 0;
+        if (*end) names[id] = strdup(end);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && !strcmp(argv[2], "--ids")) {
+        if (read_ids(argv[3])) {
+            perror(argv[3]);
+            return 1;
+        }
+    } else if (argc != 2) {
+        fprintf(stderr, "usage: trace TRACE.BIN [--ids FILE]\n");
+        return 2;
+    }
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    static uint8_t sector[TRACE_SECTOR_SIZE];
+    const struct trace_file_header *header = (const struct trace_file_header *) sector;
+    if (fread(sector, 1, sizeof(sector), f) != sizeof(sector) || header->magic != TRACE_MAGIC ||
+        header->version != TRACE_VERSION || header->record_size < sizeof(struct trace_record)) {
+        fprintf(stderr, "%s: not a TRACE.BIN\n", argv[1]);
+        return 1;
+    }
+    uint32_t count = header->record_count, record_size = header->record_size;
+    for (int core = 0; core < 2; core++) {
+        if (header->ring[core]) {
+            printf("core %d: ring at %08x, %u events before these lost\n", core, header->ring[core], header->first[core]);
+        }
+    }
+    uint8_t *records = malloc((size_t) count * record_size + 1);
+    if (fread(records, record_size, count, f) != count) {
+        fprintf(stderr, "%s: truncated\n", argv[1]);
+        return 1;
+    }
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const struct trace_record *r = (const struct trace_record *) (records + (size_t) i * record_size);
+        printf("%10u %+8d  core %u  #%-8u ", r->time, i ? (int32_t) (r->time - last) : 0, r->core, r->seq);
+        if (names[r->id]) printf("%-24s", names[r->id]);
+        else printf("%-24u", r->id);
+        printf(" %08x\n", r->arg);
+        last = r->time;
+    }
+    free(records);
+    fclose(f);
+    return 0;
+}
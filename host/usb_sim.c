@@ -0,0 +1,518 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The RP2040 USB controller as usb_device_tiny sees it, driven by a scripted
+// host. The model is of what the code relies on, transaction by transaction:
+//
+// - the device hands a buffer to the controller by setting AVAIL (and FULL
+//   for IN) in its ep_buf_ctrl half; an IN or OUT token on a buffer the device
+//   doesn't own is NAKed, and on one with STALL (armed, for EP0) is STALLed
+// - the controller clears AVAIL, sets FULL and the length for OUT, clears FULL
+//   for IN, then flags the buffer in buf_status and buf_cpu_should_handle
+// - double buffered endpoints alternate between their two buffers, from
+//   buffer 0 when the device sets SEL
+// - a SETUP lands in setup_packet, disarms the EP0 stalls and sets SETUP_REC
+// - writes to the xor/set/clear aliases take effect when the device code
+//   returns, and aborts are done at once
+//
+// Bus timing, CRCs, NAK polling intervals and babble are not modelled.
+
+#include <linux/perf_event.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "runtime.h"
+#include "async_task.h"
+#include "crashdump.h"
+#include "gdb_stub.h"
+#include "program_flash_generic.h"
+#include "scsi.h"
+#include "usb_boot_device.h"
+#include "hardware/regs/intctrl.h"
+#include "hardware/structs/usb.h"
+#include "usb_sim.h"
+#include "vd_host.h"
+
+void isr_usbctrl(void);
+
+struct usb_sim_errors usb_sim_errors;
+
+static struct {
+    bool connected;
+    bool gone;
+    bool irq_enabled;
+    // the controller's next buffer, per endpoint and direction (0 IN, 1 OUT)
+    uint8_t next_buffer[USB_NUM_ENDPOINTS][2];
+    // the host's DATA0/DATA1 toggle for its next packet
+    uint8_t host_pid[USB_NUM_ENDPOINTS][2];
+    uint32_t msc_tag;
+    uint32_t picoboot_token;
+} sim;
+
+static jmp_buf worker_idle;
+
+// -------------------------------------------------------------------------------------------------------------
+// What the image has outside the USB and task code
+
+uint32_t software_git_revision = 0x5eedc0de;
+
+void _noop() {
+}
+
+void interrupt_enable(uint irq, bool enable) {
+    if (irq == USBCTRL_IRQ) sim.irq_enabled = enable;
+}
+
+void gpio_setup() {
+}
+
+// Flash, as the mapped region the virtual disk reads it through: erase sets
+// bits, program only clears them
+#define SIM_FLASH ((uint8_t *) XIP_NOCACHE_NOALLOC_BASE)
+
+void connect_internal_flash() {
+}
+
+void flash_exit_xip() {
+}
+
+void flash_enter_cmd_xip() {
+}
+
+void flash_abort() {
+}
+
+void flash_sector_erase(uint32_t addr) {
+    memset(SIM_FLASH + (addr & ~(FLASH_SECTOR_ERASE_SIZE - 1)), 0xff, FLASH_SECTOR_ERASE_SIZE);
+}
+
+void flash_page_program(uint32_t addr, const uint8_t *data) {
+    for (uint i = 0; i < FLASH_PAGE_SIZE; i++) SIM_FLASH[addr + i] &= data[i];
+}
+
+void flash_read_data(uint32_t addr, uint8_t *rx, size_t count) {
+    memcpy(rx, SIM_FLASH + addr, count);
+}
+
+// async_task_worker has run out of tasks
+void __wfe(void) {
+    longjmp(worker_idle, 1);
+}
+
+// -------------------------------------------------------------------------------------------------------------
+// Counting the device's work
+
+static struct usb_sim_stat {
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t naks;
+} stats[USB_SIM_KIND_COUNT];
+
+static const char *const kind_names[USB_SIM_KIND_COUNT] = {"SETUP", "IN", "OUT", "reset", "worker"};
+
+static int perf_fd = -1;
+static const char *counter_unit;
+static uint64_t counter_overhead;
+
+static uint64_t counter_read(void) {
+    uint64_t value;
+    if (perf_fd >= 0 && read(perf_fd, &value, sizeof(value)) == sizeof(value)) return value;
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void counter_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    perf_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    counter_unit = perf_fd >= 0 ? "instructions" : "ns";
+    // what reading the counter costs, to take off every measurement
+    counter_overhead = UINT64_MAX;
+    for (int i = 0; i < 64; i++) {
+        uint64_t start = counter_read();
+        uint64_t cost = counter_read() - start;
+        if (cost < counter_overhead) counter_overhead = cost;
+    }
+}
+
+static void record(enum usb_sim_kind kind, uint64_t cost) {
+    stats[kind].count++;
+    stats[kind].total += cost;
+    if (cost > stats[kind].max) stats[kind].max = cost;
+}
+
+void usb_sim_stats_reset(void) {
+    memset(stats, 0, sizeof(stats));
+}
+
+void usb_sim_stats_print(FILE *f, const char *title) {
+    fprintf(f, "%s (%s on this host)\n", title, counter_unit);
+    fprintf(f, "  %-8s %8s %8s %12s %10s %10s\n", "", "count", "naks", "total", "mean", "max");
+    for (uint i = 0; i < USB_SIM_KIND_COUNT; i++) {
+        if (!stats[i].count && !stats[i].naks) continue;
+        fprintf(f, "  %-8s %8llu %8llu %12llu %10llu %10llu\n", kind_names[i], (unsigned long long) stats[i].count,
+                (unsigned long long) stats[i].naks, (unsigned long long) stats[i].total,
+                (unsigned long long) (stats[i].count ? stats[i].total / stats[i].count : 0),
+                (unsigned long long) stats[i].max);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------------------
+// The controller
+
+static void __attribute__((noreturn)) sim_fail(const char *what, uint ep) {
+    fprintf(stderr, "usb_sim: EP%u: %s\n", ep, what);
+    abort();
+}
+
+// the read only registers, which only the controller writes
+#define sim_reg(r) (*(volatile uint32_t *) &usb_hw->r)
+
+static void apply_aliases(void) {
+    volatile uint32_t *regs = (volatile uint32_t *) USBCTRL_REGS_BASE;
+    volatile uint32_t *xor = regs + REG_ALIAS_XOR_BITS / 4;
+    volatile uint32_t *set = regs + REG_ALIAS_SET_BITS / 4;
+    volatile uint32_t *clr = regs + REG_ALIAS_CLR_BITS / 4;
+    for (uint i = 0; i < sizeof(usb_hw_t) / 4; i++) {
+        regs[i] = ((regs[i] ^ xor[i]) | set[i]) & ~clr[i];
+        xor[i] = set[i] = clr[i] = 0;
+    }
+    usb_hw->abort_done = ~0u;
+}
+
+// Call into the device, counting its work in *cost; false if it handed over to
+// the real bootrom instead of returning
+static bool device_call(void (*fn)(void), uint64_t *cost) {
+    jmp_buf usb_boot;
+    vd_host_usb_boot_jmp = &usb_boot;
+    uint64_t start = counter_read();
+    if (setjmp(usb_boot)) {
+        sim.gone = true;
+        return false;
+    }
+    fn();
+    uint64_t elapsed = counter_read() - start;
+    *cost += elapsed > counter_overhead ? elapsed - counter_overhead : 0;
+    apply_aliases();
+    return true;
+}
+
+static void worker_run(void) {
+    if (!setjmp(worker_idle)) async_task_worker();
+}
+
+// Let async_task_worker run until it waits for an event; false if there was
+// nothing for it to do
+static bool run_worker(void) {
+    if (!virtual_disk_queue.full && !picoboot_queue.full
+#ifdef USE_GDB_STUB
+        && !gdb_stub_queue.full
+#endif
+            ) {
+        return false;
+    }
+    uint64_t cost = 0;
+    if (device_call(worker_run, &cost)) record(USB_SIM_WORKER, cost);
+    return true;
+}
+
+// Raise USBCTRL_IRQ until the device has dealt with everything, counting it
+// against the transaction that caused it
+static void interrupt(enum usb_sim_kind kind) {
+    uint64_t cost = 0;
+    for (uint i = 0;; i++) {
+        uint32_t intr = 0;
+        if (usb_hw->buf_status) intr |= USB_INTS_BUFF_STATUS_BITS;
+        if (usb_hw->sie_status & USB_SIE_STATUS_SETUP_REC_BITS) intr |= USB_INTS_SETUP_REQ_BITS;
+        if (usb_hw->sie_status & USB_SIE_STATUS_BUS_RESET_BITS) intr |= USB_INTS_BUS_RESET_BITS;
+        if (usb_hw->sie_status & USB_SIE_STATUS_DATA_SEQ_ERROR_BITS) intr |= USB_INTS_ERROR_DATA_SEQ_BITS;
+        sim_reg(intr) = intr;
+        sim_reg(ints) = intr & usb_hw->inte;
+        if (!usb_hw->ints || !sim.irq_enabled) break;
+        if (i == 8) sim_fail("interrupt never cleared", 0);
+        if (!device_call(isr_usbctrl, &cost)) return;
+    }
+    record(kind, cost);
+}
+
+static io_rw_16 *buf_ctrl(uint ep, bool in, uint which) {
+    io_rw_32 *wide = in ? &usb_dpram->ep_buf_ctrl[ep].in : &usb_dpram->ep_buf_ctrl[ep].out;
+    return &((io_rw_16 *) wide)[which];
+}
+
+static uint32_t ep_ctrl(uint ep, bool in) {
+    return in ? usb_dpram->ep_ctrl[ep - 1].in : usb_dpram->ep_ctrl[ep - 1].out;
+}
+
+static bool double_buffered(uint ep, bool in) {
+    return ep && (ep_ctrl(ep, in) & EP_CTRL_DOUBLE_BUFFERED_BITS);
+}
+
+static uint8_t *buffer(uint ep, bool in, uint which) {
+    // EP0 has the one buffer for both directions
+    if (!ep) return usb_dpram->ep0_buf_a;
+    return (uint8_t *) USBCTRL_DPRAM_BASE + (ep_ctrl(ep, in) & EP_CTRL_BUFFER_ADDRESS_BITS) + which * 64;
+}
+
+static bool stalled(uint ep, bool in) {
+    if (!(*buf_ctrl(ep, in, 0) & USB_BUF_CTRL_STALL)) return false;
+    return ep || (usb_hw->ep_stall_arm & (in ? USB_EP_STALL_ARM_EP0_IN_BITS : USB_EP_STALL_ARM_EP0_OUT_BITS));
+}
+
+// the buffer the controller uses for the next packet
+static uint take_buffer(uint ep, bool in) {
+    io_rw_16 *ctrl0 = buf_ctrl(ep, in, 0);
+    if (*ctrl0 & USB_BUF_CTRL_SEL) {
+        *ctrl0 &= ~USB_BUF_CTRL_SEL;
+        sim.next_buffer[ep][!in] = 0;
+    }
+    return sim.next_buffer[ep][!in];
+}
+
+static void check_pid(uint ep, bool in, uint16_t ctrl) {
+    if (!!(ctrl & USB_BUF_CTRL_DATA1_PID) != sim.host_pid[ep][!in]) usb_sim_errors.data_pid++;
+    sim.host_pid[ep][!in] ^= 1u;
+}
+
+static void buffer_done(uint ep, bool in, uint which) {
+    uint32_t bit = 1u << (ep * 2 + !in);
+    usb_hw->buf_status |= bit;
+    sim_reg(buf_cpu_should_handle) = (usb_hw->buf_cpu_should_handle & ~bit) | (which ? bit : 0);
+    if (double_buffered(ep, in)) sim.next_buffer[ep][!in] ^= 1u;
+}
+
+#define SIM_NAK (-1)
+#define SIM_STALL (-2)
+#define SIM_GONE (-3)
+
+static int transact_in(uint ep, uint8_t *data, uint32_t max) {
+    if (sim.gone) return SIM_GONE;
+    if (stalled(ep, true)) return SIM_STALL;
+    uint which = take_buffer(ep, true);
+    io_rw_16 *ctrl = buf_ctrl(ep, true, which);
+    if ((*ctrl & (USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL)) != (USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL)) {
+        stats[USB_SIM_IN].naks++;
+        return SIM_NAK;
+    }
+    uint len = *ctrl & USB_BUF_CTRL_LEN_MASK;
+    if (len > 64 || len > max) sim_fail("IN packet longer than expected", ep);
+    check_pid(ep, true, *ctrl);
+    memcpy(data, buffer(ep, true, which), len);
+    *ctrl &= ~(USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL);
+    buffer_done(ep, true, which);
+    interrupt(USB_SIM_IN);
+    return (int) len;
+}
+
+static int transact_out(uint ep, const uint8_t *data, uint32_t len) {
+    if (sim.gone) return SIM_GONE;
+    if (stalled(ep, false)) return SIM_STALL;
+    uint which = take_buffer(ep, false);
+    io_rw_16 *ctrl = buf_ctrl(ep, false, which);
+    if ((*ctrl & (USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_FULL)) != USB_BUF_CTRL_AVAIL) {
+        stats[USB_SIM_OUT].naks++;
+        return SIM_NAK;
+    }
+    if (len > (*ctrl & USB_BUF_CTRL_LEN_MASK)) sim_fail("OUT packet longer than the buffer", ep);
+    check_pid(ep, false, *ctrl);
+    memcpy(buffer(ep, false, which), data, len);
+    *ctrl = (*ctrl & ~(USB_BUF_CTRL_AVAIL | USB_BUF_CTRL_LEN_MASK)) | USB_BUF_CTRL_FULL | len;
+    buffer_done(ep, false, which);
+    interrupt(USB_SIM_OUT);
+    return 0;
+}
+
+// Retry NAKed packets once the worker has had a go, as the host would keep
+// polling
+static int packet_in(uint ep, uint8_t *data, uint32_t max) {
+    int r;
+    while ((r = transact_in(ep, data, max)) == SIM_NAK) {
+        if (!run_worker()) sim_fail("IN NAKed with nothing queued for the worker", ep);
+    }
+    return r;
+}
+
+static int packet_out(uint ep, const uint8_t *data, uint32_t len) {
+    int r;
+    while ((r = transact_out(ep, data, len)) == SIM_NAK) {
+        if (!run_worker()) sim_fail("OUT NAKed with nothing queued for the worker", ep);
+    }
+    return r;
+}
+
+// -------------------------------------------------------------------------------------------------------------
+// The host
+
+static void start_device(void) {
+    usb_boot_device_start(0);
+}
+
+void usb_sim_connect(void) {
+    if (sim.connected) sim_fail("connected twice", 0);
+    sim.connected = true;
+    counter_open();
+    // as _usb_boot, where the BSS is
+    memset0(usb_dpram, USB_DPRAM_SIZE);
+    usb_hw->abort_done = ~0u;
+    uint64_t cost = 0;
+    device_call(start_device, &cost);
+    usb_sim_bus_reset();
+}
+
+void usb_sim_bus_reset(void) {
+    memset(sim.next_buffer, 0, sizeof(sim.next_buffer));
+    memset(sim.host_pid, 0, sizeof(sim.host_pid));
+    usb_hw->dev_addr_ctrl = 0;
+    usb_hw->sie_status |= USB_SIE_STATUS_BUS_RESET_BITS;
+    interrupt(USB_SIM_BUS_RESET);
+}
+
+bool usb_sim_gone(void) {
+    return sim.gone;
+}
+
+uint8_t usb_sim_address(void) {
+    return usb_hw->dev_addr_ctrl & 0x7fu;
+}
+
+int usb_sim_bulk_in(unsigned int ep, void *data, uint32_t len) {
+    uint8_t packet[64];
+    uint32_t done = 0;
+    do {
+        int r = packet_in(ep, packet, MIN(len - done, 64u));
+        if (r < 0) return -1;
+        if (r) memcpy((uint8_t *) data + done, packet, r);
+        done += r;
+        if (r < 64) break;
+    } while (done < len);
+    return (int) done;
+}
+
+int usb_sim_bulk_in_poll(unsigned int ep, void *data, uint32_t len) {
+    uint8_t packet[64];
+    uint32_t done = 0;
+    do {
+        int r;
+        while ((r = transact_in(ep, packet, MIN(len - done, 64u))) == SIM_NAK) {
+            if (!run_worker()) return (int) done;
+        }
+        if (r < 0) return -1;
+        if (r) memcpy((uint8_t *) data + done, packet, r);
+        done += r;
+    } while (done < len);
+    return (int) done;
+}
+
+int usb_sim_bulk_out(unsigned int ep, const void *data, uint32_t len) {
+    uint32_t done = 0;
+    do {
+        uint32_t n = MIN(len - done, 64u);
+        if (packet_out(ep, (const uint8_t *) data + done, n) < 0) return -1;
+        done += n;
+    } while (done < len);
+    return 0;
+}
+
+int usb_sim_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, uint16_t length,
+                    void *data) {
+    if (sim.gone) return -1;
+    struct usb_setup_packet setup = {
+            .bmRequestType = request_type,
+            .bRequest = request,
+            .wValue = value,
+            .wIndex = index,
+            .wLength = length,
+    };
+    memcpy((void *) usb_dpram->setup_packet, &setup, sizeof(setup));
+    usb_hw->ep_stall_arm = 0;
+    usb_hw->sie_status |= USB_SIE_STATUS_SETUP_REC_BITS;
+    sim.host_pid[0][0] = sim.host_pid[0][1] = 1;
+    interrupt(USB_SIM_SETUP);
+
+    bool in = request_type & USB_DIR_IN;
+    int len = 0;
+    if (length) {
+        len = in ? usb_sim_bulk_in(0, data, length) : usb_sim_bulk_out(0, data, length);
+        if (len < 0) return -1;
+        if (!in) len = length;
+    }
+    // the status stage is the other way
+    if ((in && length ? usb_sim_bulk_out(0, NULL, 0) : usb_sim_bulk_in(0, NULL, 0)) < 0) return -1;
+
+    // the host's data toggles follow the device's
+    if (request_type == USB_REQ_TYPE_RECIPIENT_DEVICE && request == USB_REQUEST_SET_CONFIGURATION) {
+        for (uint ep = 1; ep < USB_NUM_ENDPOINTS; ep++) sim.host_pid[ep][0] = sim.host_pid[ep][1] = 0;
+    } else if (request_type == USB_REQ_TYPE_RECIPIENT_ENDPOINT && request == USB_REQUEST_CLEAR_FEATURE &&
+               value == USB_FEAT_ENDPOINT_HALT) {
+        sim.host_pid[index & 0xfu][!(index & USB_DIR_IN)] = 0;
+    }
+    return len;
+}
+
+bool usb_sim_enumerate(uint8_t address) {
+    uint8_t desc[256];
+    // as Linux: the start of the device descriptor, a reset, then the address
+    if (usb_sim_control(USB_DIR_IN, USB_REQUEST_GET_DESCRIPTOR, USB_DT_DEVICE << 8, 0, 64, desc) != 18) return false;
+    usb_sim_bus_reset();
+    if (usb_sim_control(0, USB_REQUEST_SET_ADDRESS, address, 0, 0, NULL) < 0) return false;
+    if (usb_sim_address() != address) return false;
+    if (usb_sim_control(USB_DIR_IN, USB_REQUEST_GET_DESCRIPTOR, USB_DT_DEVICE << 8, 0, 18, desc) != 18) return false;
+    if (usb_sim_control(USB_DIR_IN, USB_REQUEST_GET_DESCRIPTOR, USB_DT_CONFIG << 8, 0, 9, desc) != 9) return false;
+    uint16_t total = desc[2] | desc[3] << 8;
+    if (total > sizeof(desc) ||
+        usb_sim_control(USB_DIR_IN, USB_REQUEST_GET_DESCRIPTOR, USB_DT_CONFIG << 8, 0, total, desc) != total) {
+        return false;
+    }
+    return usb_sim_control(0, USB_REQUEST_SET_CONFIGURATION, 1, 0, 0, NULL) >= 0;
+}
+
+int usb_sim_msc(const uint8_t *cb, unsigned int cb_len, bool in, void *data, uint32_t len) {
+    struct scsi_cbw cbw = {
+            .sig = CBW_SIG,
+            .tag = ++sim.msc_tag,
+            .data_transfer_length = len,
+            .flags = in ? USB_DIR_IN : 0,
+            .cb_length = cb_len,
+    };
+    memcpy(cbw.cb, cb, cb_len);
+    if (usb_sim_bulk_out(USB_SIM_MSC_OUT, &cbw, 31) < 0) return -1;
+    if (len) {
+        int r = in ? usb_sim_bulk_in(USB_SIM_MSC_IN, data, len) : usb_sim_bulk_out(USB_SIM_MSC_OUT, data, len);
+        if (r < 0) return -1;
+    }
+    struct scsi_csw csw;
+    if (usb_sim_bulk_in(USB_SIM_MSC_IN, &csw, sizeof(csw)) != sizeof(csw)) return -1;
+    if (csw.sig != CSW_SIG || csw.tag != cbw.tag) sim_fail("bad CSW", USB_SIM_MSC_IN);
+    return csw.status;
+}
+
+int usb_sim_picoboot(struct picoboot_cmd *cmd, void *data) {
+    cmd->dMagic = PICOBOOT_MAGIC;
+    cmd->dToken = ++sim.picoboot_token;
+    if (usb_sim_bulk_out(USB_SIM_PICOBOOT_OUT, cmd, sizeof(*cmd)) < 0) return -1;
+    bool in = cmd->bCmdId & 0x80u;
+    if (cmd->dTransferLength) {
+        int r = in ? usb_sim_bulk_in(USB_SIM_PICOBOOT_IN, data, cmd->dTransferLength) :
+                usb_sim_bulk_out(USB_SIM_PICOBOOT_OUT, data, cmd->dTransferLength);
+        if (r < 0) return -1;
+    }
+    // acked the other way
+    int r = in ? usb_sim_bulk_out(USB_SIM_PICOBOOT_OUT, NULL, 0) : usb_sim_bulk_in(USB_SIM_PICOBOOT_IN, NULL, 0);
+    return r < 0 ? -1 : 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _USB_SIM_H
+#define _USB_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "boot/picoboot.h"
+
+// A register level model of the RP2040 USB controller (DPRAM, buffer control,
+// the set/clear aliases and the interrupt status) with a scripted host on the
+// other end of the cable, running the image's own usb_device_tiny, MSC and
+// PICOBOOT code (usb_sim.c). isr_usbctrl is called for each transaction that
+// raises an interrupt, and async_task_worker is run whenever the host is
+// NAKed. Needs vd_host_map() first.
+//
+// The device work each transaction causes is counted (usb_sim_stats_print),
+// which makes this the bench for the USB path.
+
+// The boot device's endpoints
+#define USB_SIM_MSC_IN 1
+#define USB_SIM_MSC_OUT 2
+#define USB_SIM_PICOBOOT_OUT 3
+#define USB_SIM_PICOBOOT_IN 4
+#define USB_SIM_GDB_OUT 6
+#define USB_SIM_GDB_IN 7
+
+// What _usb_boot does: the boot device, the auto resume enumeration timeout,
+// then the host resets the bus. Once only, as on the device
+void usb_sim_connect(void);
+
+void usb_sim_bus_reset(void);
+
+// After reset_usb_boot (a UF2 download) the device is gone, and every transfer
+// fails
+bool usb_sim_gone(void);
+
+// The device's USB address (dev_addr_ctrl)
+uint8_t usb_sim_address(void);
+
+// A control transfer on EP0: the data stage length, or -1 on a stall
+int usb_sim_control(uint8_t request_type, uint8_t request, uint16_t value, uint16_t index, uint16_t length,
+                    void *data);
+
+// Bulk IN until len bytes or a short packet (len 0 is one zero length packet):
+// the length, or -1 on a stall
+int usb_sim_bulk_in(unsigned int ep, void *data, uint32_t len);
+
+// Bulk IN, across packet boundaries, until len bytes or the device has nothing
+// more to send (NAKs with nothing queued for the worker), as a host polling a
+// serial port would: the length, or -1 on a stall
+int usb_sim_bulk_in_poll(unsigned int ep, void *data, uint32_t len);
+
+// Bulk OUT in 64 byte packets (len 0 is one zero length packet): 0, or -1 on a
+// stall
+int usb_sim_bulk_out(unsigned int ep, const void *data, uint32_t len);
+
+// GET_DESCRIPTOR (device, then configuration), SET_ADDRESS and
+// SET_CONFIGURATION 1, as a host would: false if any of them failed
+bool usb_sim_enumerate(uint8_t address);
+
+// A mass storage bulk only transport command: the CBW, len bytes of data
+// stage in (to data) or out (from data), and the CSW. The CSW status, or -1 on
+// a stall
+int usb_sim_msc(const uint8_t *cb, unsigned int cb_len, bool in, void *data, uint32_t len);
+
+// A PICOBOOT command (magic and token are filled in), its data stage
+// (direction from bCmdId, length from dTransferLength) and the ack: 0, or -1 on
+// a stall
+int usb_sim_picoboot(struct picoboot_cmd *cmd, void *data);
+
+// Errors the host saw, which the device code should never cause
+struct usb_sim_errors {
+    unsigned int data_pid; // DATA0/DATA1 toggle out of step
+};
+extern struct usb_sim_errors usb_sim_errors;
+
+enum usb_sim_kind {
+    USB_SIM_SETUP,
+    USB_SIM_IN,
+    USB_SIM_OUT,
+    USB_SIM_BUS_RESET,
+    USB_SIM_WORKER,
+    USB_SIM_KIND_COUNT
+};
+
+// Device work since the last reset, per transaction kind (worker is per
+// async_task_worker run). In user mode instructions on this host when perf
+// events are available, otherwise thread CPU nanoseconds; either way a proxy
+// for comparing builds, not Cortex-M0+ cycles
+void usb_sim_stats_reset(void);
+void usb_sim_stats_print(FILE *f, const char *title);
+
+#endif
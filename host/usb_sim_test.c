@@ -0,0 +1,402 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The image's USB side end to end, as a host would drive it over the cable, for
+// a made up crash: enumeration, mass storage (reading the whole dump, then a
+// UF2 download), PICOBOOT (with the dump stream) and the gdb stub. Prints what
+// each step cost the device
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vd_host.h"
+#include "usb_sim.h"
+#include "crashdump.h"
+#include "crash_ring.h"
+#include "minidump_decode.h"
+#include "log.h"
+#include "boot/uf2.h"
+#include "hardware/structs/watchdog.h"
+
+#define check(x) do { if (!(x)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); exit(1); } } while (0)
+
+#define BLOCK_ADDR 0x20000400u
+// where the made up application keeps its vector table and region table
+#define VECTORS_FLASH_OFFSET 0x20000u
+#define REGIONS_FLASH_OFFSET 0x8000u
+
+#define GET_DESCRIPTOR 6
+#define REQUEST_IN_VENDOR_INTERFACE 0xc1
+#define REQUEST_OUT_VENDOR_INTERFACE 0x41
+#define REQUEST_IN_CLASS_INTERFACE 0xa1
+#define REQUEST_OUT_CLASS_INTERFACE 0x21
+
+#define CDC_SET_LINE_CODING 0x20
+#define CDC_GET_LINE_CODING 0x21
+#define CDC_SET_CONTROL_LINE_STATE 0x22
+#define GDB_COMM_INTERFACE 2
+
+#define SCSI_INQUIRY 0x12
+#define SCSI_READ_CAPACITY_10 0x25
+#define SCSI_READ_10 0x28
+#define SCSI_WRITE_10 0x2a
+
+static uint8_t buf[VD_HOST_SECTOR_SIZE];
+
+static uint16_t le16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return le16(p) | (uint32_t) le16(p + 2) << 16;
+}
+
+static uint32_t be32(const uint8_t *p) {
+    return (uint32_t) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void make_crash(void) {
+    for (uint32_t i = 0; i < 1024; i++) ((uint8_t *) SRAM_BASE)[i] = i;
+    memcpy((void *) SRAM_BASE, "Hello, crash!\n", 14);
+
+    struct crashdump_block *block = (struct crashdump_block *) BLOCK_ADDR;
+    memset(block, 0, sizeof(*block));
+    block->magic = CRASHDUMP_BLOCK_MAGIC;
+    block->size = sizeof(*block);
+    block->crashed_core = 1;
+    block->core[1].r[15] = 0x10001234;
+    block->core[1].state = CRASHDUMP_STATE_FAULTED;
+    block->core[0].state = CRASHDUMP_STATE_FROZEN;
+    // it called crashdump_persist, so there is somewhere to go back to
+    uint32_t *vectors = (uint32_t *) (XIP_NOCACHE_NOALLOC_BASE + VECTORS_FLASH_OFFSET);
+    vectors[0] = SRAM_END;
+    vectors[1] = XIP_BASE + VECTORS_FLASH_OFFSET + 0x101;
+    block->resume_vector = XIP_BASE + VECTORS_FLASH_OFFSET;
+
+    static const struct crashdump_region regions[] = {
+            {0x20000020, 4, 0, CRASHDUMP_REGION_SENSITIVE, 0, "key"},
+    };
+    memcpy((void *) (XIP_NOCACHE_NOALLOC_BASE + REGIONS_FLASH_OFFSET), regions, sizeof(regions));
+    block->regions = XIP_BASE + REGIONS_FLASH_OFFSET;
+    block->regions_size = sizeof(regions);
+
+    // just the scratch registers (not vd_host_set_crash): usb_sim_connect
+    // does the rest as _usb_boot does
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_MAGIC;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_BLOCK] = BLOCK_ADDR;
+}
+
+static int scsi_rw(uint8_t op, uint32_t lba, uint16_t blocks, void *data) {
+    uint8_t cb[10] = {op, 0, lba >> 24, lba >> 16, lba >> 8, lba, 0, blocks >> 8, blocks, 0};
+    return usb_sim_msc(cb, sizeof(cb), op == SCSI_READ_10, data, blocks * VD_HOST_SECTOR_SIZE);
+}
+
+static const uint8_t *read_sector(uint32_t lba) {
+    check(!scsi_rw(SCSI_READ_10, lba, 1, buf));
+    return buf;
+}
+
+static void test_enumeration(void) {
+    // _usb_boot armed the enumeration timeout
+    check(vd_host_events.reboots == 1 && vd_host_events.reboot_pending);
+    check(vd_host_events.reboot_delay_ms == AUTO_RESUME_ENUMERATION_TIMEOUT_MS);
+
+    check(usb_sim_enumerate(9));
+    check(usb_sim_address() == 9);
+    // configured, so no reboot after all
+    check(!vd_host_events.reboot_pending);
+
+    uint8_t desc[64];
+    check(usb_sim_control(0x80, GET_DESCRIPTOR, 0x0100, 0, sizeof(desc), desc) == 18);
+    check(le16(desc + 8) == 0x2e8a);
+    check(usb_sim_control(0x80, GET_DESCRIPTOR, 0x0302, 0x0409, sizeof(desc), desc) == 2 + 2 * 8);
+    check(!memcmp(desc + 2, "R\0P\0" "2\0 \0B\0o\0o\0t\0", 16));
+}
+
+static void test_msc(void) {
+    uint8_t inquiry[6] = {SCSI_INQUIRY, 0, 0, 0, 36, 0};
+    check(!usb_sim_msc(inquiry, sizeof(inquiry), true, buf, 36));
+    check(!memcmp(buf + 8, "RPI     ", 8));
+
+    uint8_t capacity[10] = {SCSI_READ_CAPACITY_10};
+    check(!usb_sim_msc(capacity, sizeof(capacity), true, buf, 8));
+    check(be32(buf) == vd_host_sector_count() - 1 && be32(buf + 4) == VD_HOST_SECTOR_SIZE);
+
+    const uint8_t *mbr = read_sector(0);
+    check(mbr[510] == 0x55 && mbr[511] == 0xaa);
+}
+
+// The first sector of a file in the root directory (its clusters are in
+// order), and its size
+static uint32_t find_file(const char *name, uint32_t *size) {
+    uint32_t part_start = le32(read_sector(0) + 446 + 8);
+    const uint8_t *boot = read_sector(part_start);
+    uint32_t sectors_per_cluster = boot[0x0d];
+    uint32_t fat_start = part_start + le16(boot + 0x0e);
+    uint32_t root_start = fat_start + boot[0x10] * le16(boot + 0x16);
+    uint32_t data_start = root_start + le16(boot + 0x11) * 32 / VD_HOST_SECTOR_SIZE;
+
+    const uint8_t *root = read_sector(root_start), *e = root;
+    while (e < root + VD_HOST_SECTOR_SIZE && memcmp(e, name, 11)) e += 32;
+    check(e < root + VD_HOST_SECTOR_SIZE);
+    *size = le32(e + 28);
+    return data_start + (le16(e + 26) - 2) * sectors_per_cluster;
+}
+
+// What _usb_boot set up before arming the enumeration timeout, and the drive
+// laid out on configuration, saw the capture block
+static void test_block_seen(void) {
+    uint32_t size;
+    uint32_t first = find_file("CRASHDMPXXD", &size);
+    // the key is sensitive
+    check(!memcmp(read_sector(first) + 128, "00020 ---- ---- 2425 2627 2829 2a2b 2c2d 2e2f  ----$%&'()*+,-./\n", 64));
+    // and MINIDUMP.BIN, laid out on configuration, has the block
+    first = find_file("MINIDUMPBIN", &size);
+    const uint8_t *file = read_sector(first);
+    const struct minidump_header *header = (const struct minidump_header *) file;
+    check(header->magic == MINIDUMP_MAGIC && header->region_count && header->size == size);
+    check(minidump_region(file, 0)->type == MINIDUMP_REGION_BLOCK && minidump_region(file, 0)->addr == BLOCK_ADDR);
+}
+
+// the whole of CRASHDMP.XXD, 64K at a time as Linux would, resumes the
+// application once
+static void test_read_dump(void) {
+    uint32_t size;
+    uint32_t first = find_file("CRASHDMPXXD", &size);
+    check(size == 4 * CRASH_RING_DATA_SIZE);
+
+    usb_sim_stats_reset();
+    uint32_t sectors = size / VD_HOST_SECTOR_SIZE;
+    uint8_t *dump = malloc(size);
+    for (uint32_t i = 0; i < sectors; i += 128) {
+        uint16_t n = sectors - i < 128 ? sectors - i : 128;
+        check(!vd_host_events.reboot_pending);
+        check(!scsi_rw(SCSI_READ_10, first + i, n, dump + i * VD_HOST_SECTOR_SIZE));
+    }
+    usb_sim_stats_print(stdout, "READ(10) of CRASHDMP.XXD");
+    check(!memcmp(dump, "00000 4865 6c6c 6f2c 2063 7261 7368 210a 0e0f  Hello, crash!...\n", 64));
+    free(dump);
+    check(vd_host_events.reboots == 2 && vd_host_events.reboot_pending);
+    check(vd_host_events.reboot_delay_ms == AUTO_RESUME_DELAY_MS);
+}
+
+// Without a resume vector there is nothing to go back to but this image,
+// which would fill SRAM over the crash: it stays in dump mode
+static void test_no_resume_vector(void) {
+    struct crashdump_block *block = (struct crashdump_block *) BLOCK_ADDR;
+    block->resume_vector = 0;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = CRASHDUMP_MAGIC;
+    unsigned int reboots = vd_host_events.reboots;
+    crashdump_arm_enumeration_timeout();
+    vd_eject();
+    check(vd_host_events.reboots == reboots);
+    check(watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] == CRASHDUMP_MAGIC);
+}
+
+static void check_picoboot_status(const struct picoboot_cmd *cmd) {
+    struct picoboot_cmd_status status;
+    check(usb_sim_control(REQUEST_IN_VENDOR_INTERFACE, PICOBOOT_IF_CMD_STATUS, 0, 1, sizeof(status), &status) ==
+          sizeof(status));
+    check(status.dToken == cmd->dToken && status.bCmdId == cmd->bCmdId);
+    check(status.dStatusCode == PICOBOOT_OK && !status.bInProgress);
+}
+
+static void test_picoboot(void) {
+    static uint8_t data[1024];
+    usb_sim_stats_reset();
+    struct picoboot_cmd cmd = {
+            .bCmdId = PC_READ,
+            .bCmdSize = sizeof(struct picoboot_range_cmd),
+            .dTransferLength = sizeof(data),
+            .range_cmd = {SRAM_BASE, sizeof(data)},
+    };
+    check(!usb_sim_picoboot(&cmd, data));
+    check(!memcmp(data, (const void *) SRAM_BASE, sizeof(data)));
+    check(!memcmp(data, "Hello, crash!\n", 14));
+    check_picoboot_status(&cmd);
+    usb_sim_stats_print(stdout, "PICOBOOT READ of 1K of SRAM");
+
+    for (uint32_t i = 0; i < sizeof(data); i++) data[i] = ~i;
+    cmd = (struct picoboot_cmd) {
+            .bCmdId = PC_WRITE,
+            .bCmdSize = sizeof(struct picoboot_range_cmd),
+            .dTransferLength = sizeof(data),
+            .range_cmd = {SRAM_BASE + 0x10000, sizeof(data)},
+    };
+    check(!usb_sim_picoboot(&cmd, data));
+    check(!memcmp(data, (const void *) (SRAM_BASE + 0x10000), sizeof(data)));
+    check_picoboot_status(&cmd);
+
+    // flash is erased
+    cmd = (struct picoboot_cmd) {
+            .bCmdId = PC_READ,
+            .bCmdSize = sizeof(struct picoboot_range_cmd),
+            .dTransferLength = 256,
+            .range_cmd = {XIP_BASE, 256},
+    };
+    check(!usb_sim_picoboot(&cmd, data));
+    for (uint32_t i = 0; i < 256; i++) check(data[i] == 0xff);
+}
+
+static void test_picoboot_dump(void) {
+    static uint8_t dump[MINIDUMP_DUMP_SIZE];
+    usb_sim_stats_reset();
+    struct picoboot_cmd cmd = {
+            .bCmdId = PC_CRASHDUMP_DUMP,
+            .bCmdSize = sizeof(struct picoboot_range_cmd),
+            .dTransferLength = sizeof(dump),
+            .range_cmd = {0, sizeof(dump)},
+    };
+    check(!usb_sim_picoboot(&cmd, dump));
+    check_picoboot_status(&cmd);
+    usb_sim_stats_print(stdout, "PICOBOOT dump of all of SRAM");
+    check(!minidump_check(dump, sizeof(dump)));
+    const struct minidump_region *sram = minidump_region(dump, 0), *block = minidump_region(dump, 1);
+    check(((const struct minidump_header *) dump)->region_count == 2);
+    check(sram->type == MINIDUMP_REGION_SRAM && sram->addr == SRAM_BASE && sram->size == SRAM_END - SRAM_BASE);
+    // but the key, which is sensitive
+    check(!memcmp(dump + sram->offset, (const void *) SRAM_BASE, 0x20));
+    check(!memcmp(dump + sram->offset + 0x20, "\0\0\0\0", 4));
+    check(!memcmp(dump + sram->offset + 0x24, (const void *) (SRAM_BASE + 0x24), sram->size - 0x24));
+    check(block->type == MINIDUMP_REGION_BLOCK && block->addr == BLOCK_ADDR && block->core == 1);
+    check(block->offset == sram->offset + BLOCK_ADDR - SRAM_BASE);
+
+    // the capture block's core as a thread, the crashed one first
+    char *core;
+    size_t core_size;
+    FILE *f = open_memstream(&core, &core_size);
+    check(minidump_to_core(f, dump));
+    fclose(f);
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *) core;
+    check(!memcmp(ehdr->e_ident, ELFMAG, SELFMAG) && ehdr->e_type == ET_CORE && ehdr->e_machine == EM_ARM);
+    // the block is inside SRAM
+    check(ehdr->e_phnum == 2);
+    const Elf32_Phdr *phdr = (const Elf32_Phdr *) (core + ehdr->e_phoff);
+    check(phdr[0].p_type == PT_NOTE && phdr[0].p_filesz == 2 * (12 + 8 + 148));
+    check(le32((const uint8_t *) core + phdr[0].p_offset + 20 + 72 + 15 * 4) == 0x10001234);
+    check(phdr[1].p_type == PT_LOAD && phdr[1].p_vaddr == SRAM_BASE && phdr[1].p_filesz == SRAM_END - SRAM_BASE);
+    check(!memcmp(core + phdr[1].p_offset, dump + sram->offset, phdr[1].p_filesz));
+    free(core);
+
+    // or from part way, a sector at a time
+    cmd.range_cmd = (struct picoboot_range_cmd) {2 * MINIDUMP_SECTOR_SIZE, 1024};
+    cmd.dTransferLength = 1024;
+    check(!usb_sim_picoboot(&cmd, dump));
+    check(!memcmp(dump, (const void *) (SRAM_BASE + MINIDUMP_SECTOR_SIZE), 1024));
+    cmd.range_cmd.dAddr = 100;
+    check(usb_sim_picoboot(&cmd, dump) == -1);
+    struct picoboot_cmd_status status;
+    check(usb_sim_control(REQUEST_IN_VENDOR_INTERFACE, PICOBOOT_IF_CMD_STATUS, 0, 1, sizeof(status), &status) ==
+          sizeof(status));
+    check(status.dStatusCode == PICOBOOT_BAD_ALIGNMENT);
+    check(usb_sim_control(REQUEST_OUT_VENDOR_INTERFACE, PICOBOOT_IF_RESET, 0, 1, 0, NULL) == 0);
+}
+
+// Send a packet, and return its reply (less the ack, $, and checksum, which
+// are checked)
+static const char *gdb_command(const char *cmd, bool ack) {
+    static char packet[600], reply[600];
+    uint8_t sum = 0;
+    for (const char *c = cmd; *c; c++) sum += (uint8_t) *c;
+    int len = snprintf(packet, sizeof(packet), "$%s#%02x", cmd, sum);
+    check(!usb_sim_bulk_out(USB_SIM_GDB_OUT, packet, len));
+    len = usb_sim_bulk_in_poll(USB_SIM_GDB_IN, reply, sizeof(reply) - 1);
+    check(len >= 4);
+    reply[len] = 0;
+    char *r = reply;
+    if (ack) check(*r++ == '+');
+    check(*r++ == '$' && reply[len - 3] == '#');
+    sum = 0;
+    for (char *c = r; c < reply + len - 3; c++) sum += (uint8_t) *c;
+    check(strtoul(reply + len - 2, NULL, 16) == sum);
+    reply[len - 3] = 0;
+    return r;
+}
+
+static void test_gdb(void) {
+    // what a serial port is opened with
+    uint8_t coding[7] = {0x00, 0xc2, 0x01, 0x00, 0, 0, 8};
+    check(usb_sim_control(REQUEST_OUT_CLASS_INTERFACE, CDC_SET_LINE_CODING, 0, GDB_COMM_INTERFACE, sizeof(coding),
+                          coding) == sizeof(coding));
+    memset(coding, 0, sizeof(coding));
+    check(usb_sim_control(REQUEST_IN_CLASS_INTERFACE, CDC_GET_LINE_CODING, 0, GDB_COMM_INTERFACE, sizeof(coding),
+                          coding) == sizeof(coding));
+    check(le32(coding) == 115200 && coding[6] == 8);
+    check(usb_sim_control(REQUEST_OUT_CLASS_INTERFACE, CDC_SET_CONTROL_LINE_STATE, 3, GDB_COMM_INTERFACE, 0,
+                          NULL) == 0);
+
+    usb_sim_stats_reset();
+    // longer than a packet
+    const char *cmd = "qSupported:multiprocess+;swbreak+;hwbreak+;qRelocInsn+;fork-events+;vfork-events+;exec-events+";
+    check(strstr(gdb_command(cmd, true), "qXfer:memory-map:read+"));
+    // gdb acks each reply
+    check(!usb_sim_bulk_out(USB_SIM_GDB_OUT, "+", 1));
+    check(!strcmp(gdb_command("QStartNoAckMode", true), "OK"));
+    check(!strcmp(gdb_command("?", false), "T05thread:02;"));
+    // core 1 crashed at 0x10001234
+    const char *regs = gdb_command("g", false);
+    check(strlen(regs) == 17 * 8 && !strncmp(regs + 15 * 8, "34120010", 8));
+    check(!strcmp(gdb_command("Hg1", false), "OK"));
+    check(!strcmp(gdb_command("p0f", false), "00000000"));
+    check(!strcmp(gdb_command("m20000000,e", false), "48656c6c6f2c206372617368210a"));
+    usb_sim_stats_print(stdout, "gdb stub commands");
+    // flash is erased; a read from the middle of a page
+    check(!strcmp(gdb_command("m10000010,4", false), "ffffffff"));
+    check(!strcmp(gdb_command("m40000000,4", false), "E01"));
+    check(!strncmp(gdb_command("qXfer:memory-map:read::0,400", false), "l<memory-map>", 13));
+    check(!strcmp(gdb_command("vMustReplyEmpty", false), ""));
+}
+
+// LOG.BIN's, as it is
+static uint32_t log_head(void) {
+    log_read(0, buf);
+    const struct log_ring *ring = (const struct log_ring *) buf;
+    check(ring->magic == LOG_MAGIC);
+    return ring->head;
+}
+
+static void test_uf2_hands_over(void) {
+    uint8_t block[VD_HOST_SECTOR_SIZE] = {0};
+    struct uf2_block *uf2 = (struct uf2_block *) block;
+    uf2->magic_start0 = UF2_MAGIC_START0;
+    uf2->magic_start1 = UF2_MAGIC_START1;
+    uf2->magic_end = UF2_MAGIC_END;
+    uf2->flags = UF2_FLAG_FAMILY_ID_PRESENT;
+    uf2->file_size = RP2040_FAMILY_ID;
+    // flash, so the UF2 bitmaps are cleared
+    uf2->target_addr = XIP_BASE;
+    uf2->payload_size = 256;
+    uf2->num_blocks = 1;
+    uint32_t logged = log_head();
+    // the device is gone before the CSW
+    check(scsi_rw(SCSI_WRITE_10, 1000, 1, block) == -1);
+    check(vd_host_events.usb_boots == 1 && usb_sim_gone());
+    // the log went on as the UF2 bitmaps were cleared
+    check(log_head() > logged);
+}
+
+int main(void) {
+    check(vd_host_map());
+    make_crash();
+
+    usb_sim_connect();
+    test_enumeration();
+    usb_sim_stats_print(stdout, "Enumeration");
+    test_msc();
+    test_block_seen();
+    test_picoboot();
+    test_picoboot_dump();
+    // before the dump is read, and the application is resumed
+    test_gdb();
+    test_read_dump();
+    test_no_resume_vector();
+    test_uf2_hands_over();
+    check(!usb_sim_errors.data_pid);
+    printf("usb_sim_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,319 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Serve the crash dump image's virtual disk on a Linux host, from a RAM
+// snapshot: as a disk image file, over NBD (read only), or just time it.
+//
+//      vd_host --ram sram.bin [--flash flash.bin] [--block ADDR]
+//              (--image disk.img | --nbd PORT | --bench N)
+//
+// e.g. vd_host --ram sram.bin --block 0x20000400 --nbd 10809 &
+//      nbd-client -N crash localhost 10809 /dev/nbd0 && mount -o ro /dev/nbd0p1 /mnt
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vd_host.h"
+
+#define SRAM_BASE 0x20000000u
+#define SRAM_SIZE (264u * 1024u)
+#define XIP_BASE 0x13000000u // XIP_NOCACHE_NOALLOC_BASE, which the image reads flash through
+#define FLASH_SIZE (16u << 20)
+
+static void usage(void) {
+    fprintf(stderr, "usage: vd_host --ram FILE [--flash FILE] [--block ADDR] "
+                    "(--image FILE | --nbd PORT | --bench N)\n");
+    exit(2);
+}
+
+static bool is_zero(const uint8_t *buf) {
+    for (uint32_t i = 0; i < VD_HOST_SECTOR_SIZE; i++) {
+        if (buf[i]) return false;
+    }
+    return true;
+}
+
+// The whole disk, leaving holes for zero sectors (most of it)
+static int write_image(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    uint8_t buf[VD_HOST_SECTOR_SIZE];
+    for (uint32_t lba = 0; lba < vd_host_sector_count(); lba++) {
+        vd_read_block(0, lba, buf, sizeof(buf));
+        if (is_zero(buf)) continue;
+        if (pwrite(fd, buf, sizeof(buf), (off_t) lba * VD_HOST_SECTOR_SIZE) != sizeof(buf)) {
+            close(fd);
+            return -1;
+        }
+    }
+    int ret = ftruncate(fd, (off_t) vd_host_sector_count() * VD_HOST_SECTOR_SIZE);
+    return close(fd) || ret ? -1 : 0;
+}
+
+static int bench(int rounds) {
+    uint8_t buf[VD_HOST_SECTOR_SIZE];
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < rounds; i++) {
+        for (uint32_t lba = 0; lba < vd_host_sector_count(); lba++) {
+            vd_read_block(0, lba, buf, sizeof(buf));
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+    double sectors = (double) rounds * vd_host_sector_count();
+    printf("%.0f sectors in %.3f s: %.1f ns/sector\n", sectors, ns / 1e9, ns / sectors);
+    return 0;
+}
+
+// --- NBD (fixed newstyle handshake, then transmission; see the NBD protocol doc) ---
+
+#define NBD_MAGIC               0x4e42444d41474943ull // "NBDMAGIC"
+#define NBD_IHAVEOPT            0x49484156454f5054ull // "IHAVEOPT"
+#define NBD_REP_MAGIC           0x0003e889045565a9ull
+#define NBD_REQUEST_MAGIC       0x25609513u
+#define NBD_SIMPLE_REPLY_MAGIC  0x67446698u
+
+#define NBD_FLAG_FIXED_NEWSTYLE 0x0001u
+#define NBD_FLAG_NO_ZEROES      0x0002u
+#define NBD_FLAG_HAS_FLAGS      0x0001u
+#define NBD_FLAG_READ_ONLY      0x0002u
+
+#define NBD_OPT_EXPORT_NAME     1
+#define NBD_OPT_ABORT           2
+#define NBD_OPT_INFO            6
+#define NBD_OPT_GO              7
+#define NBD_REP_ACK             1
+#define NBD_REP_INFO            3
+#define NBD_REP_ERR_UNSUP       0x80000001u
+#define NBD_INFO_EXPORT         0
+
+#define NBD_CMD_READ            0
+#define NBD_CMD_WRITE           1
+#define NBD_CMD_DISC            2
+#define NBD_CMD_FLUSH           3
+
+#define NBD_EPERM               1
+#define NBD_EINVAL              22
+
+static bool nbd_read(int fd, void *buf, size_t len) {
+    for (uint8_t *p = buf; len;) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool nbd_write(int fd, const void *buf, size_t len) {
+    for (const uint8_t *p = buf; len;) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool nbd_write_u16(int fd, uint16_t x) {
+    x = htobe16(x);
+    return nbd_write(fd, &x, sizeof(x));
+}
+
+static bool nbd_write_u32(int fd, uint32_t x) {
+    x = htobe32(x);
+    return nbd_write(fd, &x, sizeof(x));
+}
+
+static bool nbd_write_u64(int fd, uint64_t x) {
+    x = htobe64(x);
+    return nbd_write(fd, &x, sizeof(x));
+}
+
+static bool nbd_option_reply(int fd, uint32_t option, uint32_t type, uint32_t len) {
+    return nbd_write_u64(fd, NBD_REP_MAGIC) && nbd_write_u32(fd, option) && nbd_write_u32(fd, type) &&
+           nbd_write_u32(fd, len);
+}
+
+static const uint16_t nbd_transmission_flags = NBD_FLAG_HAS_FLAGS | NBD_FLAG_READ_ONLY;
+
+// true once the client has picked the (only) export
+static bool nbd_handshake(int fd) {
+    uint64_t size = (uint64_t) vd_host_sector_count() * VD_HOST_SECTOR_SIZE;
+    uint32_t client_flags;
+    if (!nbd_write_u64(fd, NBD_MAGIC) || !nbd_write_u64(fd, NBD_IHAVEOPT) ||
+        !nbd_write_u16(fd, NBD_FLAG_FIXED_NEWSTYLE | NBD_FLAG_NO_ZEROES) ||
+        !nbd_read(fd, &client_flags, sizeof(client_flags))) {
+        return false;
+    }
+    bool no_zeroes = be32toh(client_flags) & NBD_FLAG_NO_ZEROES;
+    for (;;) {
+        struct __attribute__((packed)) {
+            uint64_t magic;
+            uint32_t option;
+            uint32_t len;
+        } opt;
+        if (!nbd_read(fd, &opt, sizeof(opt)) || be64toh(opt.magic) != NBD_IHAVEOPT) return false;
+        uint32_t option = be32toh(opt.option), len = be32toh(opt.len);
+        // we have one export, so don't care about names or info requests
+        for (uint8_t skip[256]; len;) {
+            uint32_t n = len < sizeof(skip) ? len : sizeof(skip);
+            if (!nbd_read(fd, skip, n)) return false;
+            len -= n;
+        }
+        switch (option) {
+            case NBD_OPT_EXPORT_NAME: {
+                static const uint8_t zeroes[124];
+                return nbd_write_u64(fd, size) && nbd_write_u16(fd, nbd_transmission_flags) &&
+                       (no_zeroes || nbd_write(fd, zeroes, sizeof(zeroes)));
+            }
+            case NBD_OPT_INFO:
+            case NBD_OPT_GO:
+                if (!nbd_option_reply(fd, option, NBD_REP_INFO, 12) || !nbd_write_u16(fd, NBD_INFO_EXPORT) ||
+                    !nbd_write_u64(fd, size) || !nbd_write_u16(fd, nbd_transmission_flags) ||
+                    !nbd_option_reply(fd, option, NBD_REP_ACK, 0)) {
+                    return false;
+                }
+                if (option == NBD_OPT_GO) return true;
+                break;
+            case NBD_OPT_ABORT:
+                nbd_option_reply(fd, option, NBD_REP_ACK, 0);
+                return false;
+            default:
+                if (!nbd_option_reply(fd, option, NBD_REP_ERR_UNSUP, 0)) return false;
+                break;
+        }
+    }
+}
+
+static bool nbd_reply(int fd, uint32_t error, uint64_t handle) {
+    return nbd_write_u32(fd, NBD_SIMPLE_REPLY_MAGIC) && nbd_write_u32(fd, error) &&
+           nbd_write(fd, &handle, sizeof(handle));
+}
+
+static void nbd_transmission(int fd) {
+    uint8_t buf[VD_HOST_SECTOR_SIZE];
+    uint64_t size = (uint64_t) vd_host_sector_count() * VD_HOST_SECTOR_SIZE;
+    for (;;) {
+        struct __attribute__((packed)) {
+            uint32_t magic;
+            uint16_t flags;
+            uint16_t type;
+            uint64_t handle; // opaque, so sent back as is
+            uint64_t offset;
+            uint32_t len;
+        } req;
+        if (!nbd_read(fd, &req, sizeof(req)) || be32toh(req.magic) != NBD_REQUEST_MAGIC) return;
+        uint64_t offset = be64toh(req.offset);
+        uint32_t len = be32toh(req.len);
+        switch (be16toh(req.type)) {
+            case NBD_CMD_READ:
+                if ((offset | len) % VD_HOST_SECTOR_SIZE || offset + len > size) {
+                    if (!nbd_reply(fd, NBD_EINVAL, req.handle)) return;
+                    break;
+                }
+                if (!nbd_reply(fd, 0, req.handle)) return;
+                for (uint32_t lba = offset / VD_HOST_SECTOR_SIZE; len; lba++, len -= VD_HOST_SECTOR_SIZE) {
+                    vd_read_block(0, lba, buf, sizeof(buf));
+                    if (!nbd_write(fd, buf, sizeof(buf))) return;
+                }
+                break;
+            case NBD_CMD_WRITE:
+                // read only (UF2 downloads go to the real bootrom anyway)
+                for (; len; len -= len < sizeof(buf) ? len : sizeof(buf)) {
+                    if (!nbd_read(fd, buf, len < sizeof(buf) ? len : sizeof(buf))) return;
+                }
+                if (!nbd_reply(fd, NBD_EPERM, req.handle)) return;
+                break;
+            case NBD_CMD_FLUSH:
+                if (!nbd_reply(fd, 0, req.handle)) return;
+                break;
+            case NBD_CMD_DISC:
+                return;
+            default:
+                if (!nbd_reply(fd, NBD_EINVAL, req.handle)) return;
+                break;
+        }
+    }
+}
+
+static int serve_nbd(int port) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+        bind(listener, (struct sockaddr *) &addr, sizeof(addr)) || listen(listener, 1)) {
+        return -1;
+    }
+    fprintf(stderr, "serving on localhost:%d\n", port);
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) return -1;
+        if (nbd_handshake(fd)) nbd_transmission(fd);
+        close(fd);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *ram = NULL, *flash = NULL, *image = NULL;
+    int nbd_port = 0, bench_rounds = 0;
+    uint32_t block = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 == argc) usage();
+        if (!strcmp(argv[i], "--ram")) ram = argv[++i];
+        else if (!strcmp(argv[i], "--flash")) flash = argv[++i];
+        else if (!strcmp(argv[i], "--block")) block = strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(argv[i], "--image")) image = argv[++i];
+        else if (!strcmp(argv[i], "--nbd")) nbd_port = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--bench")) bench_rounds = atoi(argv[++i]);
+        else usage();
+    }
+    if (!ram || !!image + !!nbd_port + !!bench_rounds != 1) usage();
+
+    if (!vd_host_map()) {
+        perror("mapping target memory");
+        return 1;
+    }
+    if (vd_host_load(ram, SRAM_BASE, SRAM_SIZE) < 0) {
+        perror(ram);
+        return 1;
+    }
+    if (flash && vd_host_load(flash, XIP_BASE, FLASH_SIZE) < 0) {
+        perror(flash);
+        return 1;
+    }
+    if (block) vd_host_set_crash(block);
+    vd_init();
+    vd_reset();
+
+    if (image) {
+        if (write_image(image)) {
+            perror(image);
+            return 1;
+        }
+        return 0;
+    }
+    if (bench_rounds) return bench(bench_rounds);
+    if (serve_nbd(nbd_port)) {
+        perror("nbd");
+        return 1;
+    }
+    return 0;
+}
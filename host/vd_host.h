@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _VD_HOST_H
+#define _VD_HOST_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// The host side of the virtual disk port (host_runtime.c, vd_host_stubs.c).
+// This header is for the host code, so it doesn't pull in the device headers
+// (runtime.h turns printf off, for one).
+
+#define VD_HOST_SECTOR_SIZE 512u
+
+// Map SRAM, flash (through XIP_NOCACHE_NOALLOC_BASE, erased), XIP SRAM and the
+// peripherals the device code touches at their RP2040 addresses, so that the device code can use them
+// as they are. False (with errno) if something is already there.
+bool vd_host_map(void);
+
+// Read a file into target memory at addr, up to max bytes; -1 on error
+long vd_host_load(const char *path, uint32_t addr, uint32_t max);
+
+// As if entered from a crash with the capture block at block_addr
+void vd_host_set_crash(uint32_t block_addr);
+
+uint32_t vd_host_sector_count(void);
+
+// vd_write_block, except that a UF2 download (which would hand over to the
+// real bootrom) just counts in vd_host_events.usb_boots
+bool vd_host_write_block(uint32_t token, uint32_t lba, uint8_t *buf);
+
+// What the device would have done
+struct vd_host_events {
+    unsigned int reboots;
+    uint32_t reboot_delay_ms;
+    // the last watchdog_reboot, not yet cancelled
+    bool reboot_pending;
+    unsigned int usb_boots;
+};
+extern struct vd_host_events vd_host_events;
+
+// Where reset_usb_boot (after counting in vd_host_events.usb_boots) longjmps
+// to, as the device would be gone
+extern jmp_buf *vd_host_usb_boot_jmp;
+
+#ifndef _VIRTUAL_DISK_H
+// From bootrom/virtual_disk.c, as vd_host_core builds it (without NDEBUG, so
+// with buf_size); host_runtime.c has the device's own declarations
+void vd_init();
+void vd_reset();
+void vd_eject();
+bool vd_read_block(uint32_t token, uint32_t lba, uint8_t *buf, uint32_t buf_size);
+bool vd_write_block(uint32_t token, uint32_t lba, uint8_t *buf, uint32_t buf_size);
+
+#ifdef USE_VD_CACHE
+struct vd_cache_stats {
+    uint32_t hits;
+    uint32_t misses;
+};
+extern struct vd_cache_stats vd_cache_stats;
+void vd_cache_flush();
+#endif
+#endif
+
+#endif
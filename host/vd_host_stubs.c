@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The rest of the image, for the virtual disk on its own (vd_host): no USB
+// stack, and tasks run as soon as they are queued
+
+#include <setjmp.h>
+
+#include "runtime.h"
+#include "async_task.h"
+#include "usb_boot_device.h"
+#include "virtual_disk.h"
+#include "vd_host.h"
+
+struct async_task_queue virtual_disk_queue;
+
+bool vd_host_write_block(uint32_t token, uint32_t lba, uint8_t *buf) {
+    jmp_buf usb_boot;
+    if (setjmp(usb_boot)) return false;
+    vd_host_usb_boot_jmp = &usb_boot;
+    return vd_write_block(token, lba, buf, SECTOR_SIZE);
+}
+
+void safe_reboot(uint32_t addr, uint32_t sp, uint32_t delay_ms) {
+    watchdog_reboot(addr, sp, delay_ms);
+}
+
+uint32_t msc_get_serial_number32() {
+    return 0x12345678;
+}
+
+void queue_task(__unused struct async_task_queue *queue, struct async_task *task, async_task_callback callback) {
+    // nothing to program on the host
+    task->result = 0;
+    callback(task);
+}
+
+void vd_async_complete(__unused uint32_t token, __unused uint32_t result) {
+}
+
+void reset_task(struct async_task *task) {
+    memset0(task, sizeof(struct async_task));
+}
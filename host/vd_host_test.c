@@ -0,0 +1,527 @@
+/**
+ * Copyright (c) 2020 Raspberry Pi (Trading) Ltd.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// The virtual disk, as a host would see it, for a made up crash: read back
+// through the FAT like a filesystem driver would
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vd_host.h"
+#include "bootrom_crc32.h"
+#include "crash_ring.h"
+#include "minidump_decode.h"
+#include "ram_stats.h"
+#include "trace.h"
+#include "log_decode.h"
+#include "boot/uf2.h"
+#include "hardware/structs/watchdog.h"
+
+#define check(x) do { if (!(x)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); exit(1); } } while (0)
+
+#define BLOCK_ADDR 0x20000400u
+// the application's trace rings, core 0's having wrapped
+#define TRACE_RING0 0x20020100u
+#define TRACE_RING1 0x20020500u
+// the application's crashdump_regions section, in flash
+#define REGIONS_FLASH_OFFSET 0x8000u
+// and its code, with a BL at +0x100 and a BLX at +0x200
+#define TEXT_FLASH_OFFSET 0x20000u
+
+static uint8_t buf[VD_HOST_SECTOR_SIZE];
+
+static struct {
+    uint32_t part_start;
+    uint32_t sectors_per_cluster;
+    uint32_t fat_start;
+    uint32_t sectors_per_fat;
+    uint32_t root_start;
+    uint32_t data_start;
+} fs;
+
+static const uint8_t *read_sector(uint32_t lba) {
+    memset(buf, 0xa5, sizeof(buf));
+    vd_read_block(0, lba, buf, sizeof(buf));
+    return buf;
+}
+
+static uint16_t le16(const uint8_t *p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return le16(p) | (uint32_t) le16(p + 2) << 16;
+}
+
+static uint16_t fat_entry(uint32_t cluster) {
+    return le16(read_sector(fs.fat_start + cluster * 2 / VD_HOST_SECTOR_SIZE) + cluster * 2 % VD_HOST_SECTOR_SIZE);
+}
+
+static uint32_t cluster_sector(uint32_t cluster) {
+    return fs.data_start + (cluster - 2) * fs.sectors_per_cluster;
+}
+
+// the root directory entry for an 8.3 name, or NULL
+static const uint8_t *find(const char *name) {
+    static uint8_t root[VD_HOST_SECTOR_SIZE];
+    memcpy(root, read_sector(fs.root_start), sizeof(root));
+    for (const uint8_t *e = root; e < root + sizeof(root) && *e; e += 32) {
+        if (!memcmp(e, name, 11)) return e;
+    }
+    return NULL;
+}
+
+// the whole of a file, following its FAT chain
+static uint8_t *read_file(const char *name, uint32_t *size) {
+    const uint8_t *e = find(name);
+    check(e);
+    *size = le32(e + 28);
+    uint32_t cluster = le16(e + 26);
+    uint32_t cluster_size = fs.sectors_per_cluster * VD_HOST_SECTOR_SIZE;
+    uint8_t *data = malloc((*size + cluster_size - 1) / cluster_size * cluster_size);
+    for (uint32_t offset = 0; offset < *size; offset += cluster_size) {
+        check(cluster >= 2 && cluster < 0xfff8);
+        for (uint32_t i = 0; i < fs.sectors_per_cluster; i++) {
+            memcpy(data + offset + i * VD_HOST_SECTOR_SIZE, read_sector(cluster_sector(cluster) + i), VD_HOST_SECTOR_SIZE);
+        }
+        cluster = fat_entry(cluster);
+    }
+    check(cluster == 0xffff);
+    return data;
+}
+
+static void make_crash(void) {
+    // the cold boot before it
+    for (uint32_t addr = SRAM_BASE; addr < SRAM_END; addr += 4) *(uint32_t *) (uintptr_t) addr = RAM_STATS_FILL(addr);
+    // some recognisable memory
+    for (uint32_t i = 0; i < 1024; i++) ((uint8_t *) SRAM_BASE)[i] = i;
+    memcpy((void *) SRAM_BASE, "Hello, crash!\n", 14);
+
+    struct crashdump_block *block = (struct crashdump_block *) BLOCK_ADDR;
+    memset(block, 0, sizeof(*block));
+    block->magic = CRASHDUMP_BLOCK_MAGIC;
+    block->size = sizeof(*block);
+    block->crashed_core = 1;
+    block->core[1].r[15] = 0x10001234;
+    block->core[1].state = CRASHDUMP_STATE_FAULTED;
+    block->core[0].state = CRASHDUMP_STATE_FROZEN;
+    // it called crashdump_persist
+    uint32_t *vectors = (uint32_t *) (XIP_NOCACHE_NOALLOC_BASE + TEXT_FLASH_OFFSET);
+    vectors[0] = SRAM_END;
+    vectors[1] = XIP_BASE + TEXT_FLASH_OFFSET + 0x101;
+    block->resume_vector = XIP_BASE + TEXT_FLASH_OFFSET;
+    // core 1 was in thread mode on a process stack, and core 0 was captured
+    // by an older library, without its stack top
+    block->core[1].msp = 0x20040f00;
+    block->core[1].stack_top = 0x20041000;
+    block->core[1].exc_return = 0xfffffffd;
+    block->core[1].psp = 0x20030000;
+    block->core[0].msp = 0x20041f80;
+    block->core[0].stack_top = 0x12345677;
+    memset((void *) 0x20040f00, 0xa5, 0x100);
+    memset((void *) 0x20030000, 0x5a, 0x400);
+
+    // return addresses on core 1's stack, and an odd word that isn't one
+    uint16_t *text = (uint16_t *) (XIP_NOCACHE_NOALLOC_BASE + TEXT_FLASH_OFFSET);
+    text[0x100 / 2] = 0xf000;
+    text[0x102 / 2] = 0xf800;
+    text[0x200 / 2] = 0x4798;
+    block->core[1].r[13] = 0x20030000;
+    block->core[1].r[14] = 0x10000f37;
+    ((uint32_t *) 0x20030000)[8] = XIP_BASE + TEXT_FLASH_OFFSET + 0x105;
+    ((uint32_t *) 0x20030000)[16] = XIP_BASE + TEXT_FLASH_OFFSET + 0x203;
+    ((uint32_t *) 0x20030000)[17] = XIP_BASE + TEXT_FLASH_OFFSET + 0x301;
+    block->text_start = XIP_BASE + TEXT_FLASH_OFFSET;
+    block->text_end = XIP_BASE + TEXT_FLASH_OFFSET + 0x1000;
+
+    static const struct crashdump_region regions[] = {
+            {0x20010000, 64,   1, 0,                          0, "log"},
+            {0x20000020, 4,    0, CRASHDUMP_REGION_SENSITIVE, 0, "key"},
+            {0x20020100, 4096, 0, CRASHDUMP_REGION_SKIP,      0, "cache"},
+            {0x20020000, 32,   0, 0,                          0, "state"},
+            // in core 1's stack
+            {0x20040f10, 4,    2, CRASHDUMP_REGION_SENSITIVE, 0, "token"},
+    };
+    memcpy((void *) (XIP_NOCACHE_NOALLOC_BASE + REGIONS_FLASH_OFFSET), regions, sizeof(regions));
+    block->regions = XIP_BASE + REGIONS_FLASH_OFFSET;
+    block->regions_size = sizeof(regions);
+    memset((void *) 0x20010000, 0x10, 64);
+    memset((void *) 0x20020000, 0x20, 32);
+
+    static const struct {
+        uint32_t addr, events, count, time, step;
+    } rings[] = {{TRACE_RING0, 64, 100, 100, 10}, {TRACE_RING1, 16, 20, 105, 40}};
+    for (uint32_t core = 0; core < 2; core++) {
+        struct trace_ring_header *ring = (struct trace_ring_header *) (uintptr_t) rings[core].addr;
+        *ring = (struct trace_ring_header) {TRACE_MAGIC, rings[core].addr, core, rings[core].events, rings[core].count};
+        struct trace_event *event = (struct trace_event *) (ring + 1);
+        for (uint32_t n = 0; n < rings[core].count; n++) {
+            event[n % rings[core].events] = (struct trace_event) {rings[core].time + n * rings[core].step,
+                                                                  0x100 * (core + 1) + n, n * 3};
+        }
+    }
+    vd_host_set_crash(BLOCK_ADDR);
+}
+
+// slot 0 holds an earlier crash (only its first page is non zero); slot 1 a
+// later one whose SRAM image no longer matches its data_crc, so is left out
+static void make_ring(void) {
+    static uint8_t image[CRASH_RING_DATA_SIZE];
+    memset(image, 0x5a, CRASH_RING_PAGE_SIZE);
+    for (uint slot = 0; slot < 2; slot++) {
+        uint8_t *base = (uint8_t *) (uintptr_t) crash_ring_slot_base(slot);
+        struct crash_ring_header *header = (struct crash_ring_header *) base;
+        memset(header, 0, sizeof(*header));
+        header->magic = CRASH_RING_MAGIC;
+        header->seq = 7 + slot;
+        header->data_crc = crc32_small(image, sizeof(image), 0xffffffff);
+        header->data_size = CRASH_RING_DATA_SIZE;
+        header->block_addr = BLOCK_ADDR;
+        memset(header->zero_pages, 0xff, sizeof(header->zero_pages));
+        header->zero_pages[0] &= ~1u;
+        header->header_crc = crash_ring_header_crc(header);
+        memcpy(base + CRASH_RING_DATA_OFFSET, image, CRASH_RING_PAGE_SIZE);
+    }
+    ((uint8_t *) (uintptr_t) crash_ring_slot_base(1))[CRASH_RING_DATA_OFFSET + 1] ^= 1;
+}
+
+static void test_layout(void) {
+    const uint8_t *mbr = read_sector(0);
+    check(mbr[510] == 0x55 && mbr[511] == 0xaa);
+    check(mbr[446 + 4] == 0x0e);
+    fs.part_start = le32(mbr + 446 + 8);
+    check(le32(mbr + 446 + 12) + fs.part_start == vd_host_sector_count());
+
+    const uint8_t *boot = read_sector(fs.part_start);
+    check(le16(boot + 0x0b) == VD_HOST_SECTOR_SIZE);
+    check(!memcmp(boot + 0x36, "FAT16   ", 8));
+    fs.sectors_per_cluster = boot[0x0d];
+    fs.fat_start = fs.part_start + le16(boot + 0x0e);
+    fs.sectors_per_fat = le16(boot + 0x16);
+    fs.root_start = fs.fat_start + boot[0x10] * fs.sectors_per_fat;
+    fs.data_start = fs.root_start + le16(boot + 0x11) * 32 / VD_HOST_SECTOR_SIZE;
+
+    check(find("INDEX   HTM"));
+    check(find("INFO_UF2TXT"));
+    check(find("REGS    TXT"));
+    check(find("STATS   TXT"));
+    check(find("MINIDUMPBIN"));
+    check(find("BACKTRACTXT"));
+    check(find("USAGE   TXT"));
+    check(find("TRACE   BIN"));
+    check(find("LOG     BIN"));
+    check(find("CRASHDMPXXD"));
+    check(find("CRASHDMPUF2"));
+    check(find("CRASH001BIN"));
+    check(!find("CRASH002BIN"));
+
+    // the FAT mirrors
+    uint8_t fat[VD_HOST_SECTOR_SIZE];
+    memcpy(fat, read_sector(fs.fat_start), sizeof(fat));
+    check(!memcmp(fat, read_sector(fs.fat_start + fs.sectors_per_fat), sizeof(fat)));
+    check(le16(fat) == 0xfff8);
+
+    // the bad slot's clusters are free
+    const uint8_t *e = find("CRASH001BIN");
+    uint32_t ring_clusters = (le32(e + 28) + fs.sectors_per_cluster * VD_HOST_SECTOR_SIZE - 1) /
+                             (fs.sectors_per_cluster * VD_HOST_SECTOR_SIZE);
+    uint32_t slot1 = le16(e + 26) + ring_clusters;
+    check(fat_entry(slot1 - 1) == 0xffff);
+    check(fat_entry(slot1) == 0);
+    check(fat_entry(slot1 + ring_clusters - 1) == 0);
+}
+
+static void test_regs(void) {
+    uint32_t size;
+    char *regs = (char *) read_file("REGS    TXT", &size);
+    check(size == 2 * VD_HOST_SECTOR_SIZE);
+    check(!memcmp(regs, "core   00000000\n", 16));
+    // second sector is core 1: its pc line, and then its state
+    char *core1 = regs + VD_HOST_SECTOR_SIZE;
+    check(!memcmp(core1, "core   00000001\n", 16));
+    check(!memcmp(core1 + 16 * 16, "pc     10001234\n", 16));
+    check(!memcmp(core1 + 21 * 16, "state  00000001\n", 16));
+    check(!memcmp(regs + 21 * 16, "state  00000002\n", 16));
+    free(regs);
+}
+
+static void test_stats(void) {
+    uint32_t size;
+    char *stats = (char *) read_file("STATS   TXT", &size);
+    check(size && !(size % 32));
+    for (uint32_t i = 0; i < size; i += 32) check(stats[i + 31] == '\n');
+    check(!memcmp(stats + 4 * 32, "sram_touched           ffffffff\n", 32));
+    // not cached, so up to date
+    char hits[9];
+    snprintf(hits, sizeof(hits), "%08x", vd_cache_stats.hits);
+    uint32_t line = 0;
+    while (line < size && memcmp(stats + line, "vd_cache_hits ", 14)) line += 32;
+    check(line < size && !memcmp(stats + line + 23, hits, 8));
+    free(stats);
+}
+
+static void test_minidump(void) {
+    uint32_t size;
+    uint8_t *file = read_file("MINIDUMPBIN", &size);
+    check(!minidump_check(file, size));
+    static const struct {
+        uint8_t type, core;
+        uint16_t flags;
+        uint32_t addr, size;
+    } expected[] = {
+            {MINIDUMP_REGION_BLOCK, 1, 0,                 BLOCK_ADDR, sizeof(struct crashdump_block)},
+            // up to the end of SRAM, a window short
+            {MINIDUMP_REGION_STACK, 0, 0,                 0x20041f80, 0x80},
+            {MINIDUMP_REGION_STACK, 1, 0,                 0x20040f00, 0x100},
+            {MINIDUMP_REGION_STACK, 1, MINIDUMP_FLAG_PSP, 0x20030000, MINIDUMP_STACK_WINDOW},
+            // by priority, without the sensitive and skipped ones
+            {MINIDUMP_REGION_APP,   0, 0,                 0x20020000, 32},
+            {MINIDUMP_REGION_APP,   0, 0,                 0x20010000, 64},
+    };
+    check(((const struct minidump_header *) file)->region_count == sizeof(expected) / sizeof(expected[0]));
+    for (uint32_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        const struct minidump_region *r = minidump_region(file, i);
+        check(r->type == expected[i].type && r->core == expected[i].core && r->flags == expected[i].flags);
+        check(r->addr == expected[i].addr && r->size == expected[i].size);
+        check(!(r->offset % VD_HOST_SECTOR_SIZE));
+        const uint8_t *data = file + r->offset, *mem = (const uint8_t *) (uintptr_t) r->addr;
+        for (uint32_t j = 0; j < r->size; j++) {
+            // the token is blanked
+            bool token = r->addr + j >= 0x20040f10 && r->addr + j < 0x20040f14;
+            check(data[j] == (token ? 0 : mem[j]));
+        }
+    }
+    check(!memcmp(minidump_region(file, 4)->name, "state", 6));
+
+    static uint8_t sram[SRAM_END - SRAM_BASE];
+    check(minidump_to_sram(file, sram) == BLOCK_ADDR);
+    check(sram[0x30000] == 0x5a && sram[0x40f00] == 0xa5 && !sram[0]);
+
+    // anything else is refused
+    check(minidump_check(file, size - 1));
+    file[0] ^= 1;
+    check(minidump_check(file, size));
+    free(file);
+}
+
+static void test_backtrace(void) {
+    uint32_t size;
+    char *bt = (char *) read_file("BACKTRACTXT", &size);
+    // the crashed core first, and the calls rather than the return addresses
+    static const char expected[] =
+            "core 1  pc        10001234     \n"
+            "core 1  lr        10000f37     \n"
+            "core 1  sp+00020  10020100  bl \n"
+            "core 1  sp+00040  10020200  blx\n"
+            "core 0  pc        00000000     \n"
+            "core 0  lr        00000000     \n";
+    check(size == sizeof(expected) - 1);
+    check(!memcmp(bt, expected, size));
+    free(bt);
+}
+
+static void test_usage(void) {
+    uint32_t size;
+    char *usage = (char *) read_file("USAGE   TXT", &size);
+    check(size == 14 * 32);
+    // the gaps between what make_crash wrote, the biggest being above core 1's
+    // process stack
+    check(!memcmp(usage + 2 * 32, "heap_top               20030400\n", 32));
+    // core 0's stack top is unknown
+    check(!memcmp(usage + 3 * 32, "core0_stack_used       ffffffff\n", 32));
+    check(!memcmp(usage + 5 * 32, "core1_stack_used       00000100\n"
+                                  "core1_stack_free       00010b00\n"
+                                  "untouched_20000520     0000fae0\n", 3 * 32));
+    // around the trace rings
+    check(!memcmp(usage + 10 * 32, "untouched_20020414     000000ec\n", 32));
+    check(!memcmp(usage + 13 * 32, "untouched_20041000     00001000\n", 32));
+    free(usage);
+}
+
+static void test_trace(void) {
+    uint32_t size;
+    uint8_t *file = read_file("TRACE   BIN", &size);
+    const struct trace_file_header *header = (const struct trace_file_header *) file;
+    check(header->magic == TRACE_MAGIC && header->record_size == sizeof(struct trace_record));
+    // all but the oldest slot of the ring that wrapped
+    check(header->record_count == 63 + 15);
+    check(size == VD_HOST_SECTOR_SIZE + header->record_count * sizeof(struct trace_record));
+    check(header->ring[0] == TRACE_RING0 && header->ring[1] == TRACE_RING1);
+    check(header->first[0] == 37 && header->first[1] == 5);
+    // merged in time order, across sectors
+    const struct trace_record *r = (const struct trace_record *) (file + VD_HOST_SECTOR_SIZE);
+    uint32_t next[2] = {37, 5};
+    for (uint32_t i = 0; i < header->record_count; i++, r++) {
+        check(r->core < 2 && r->seq == next[r->core]++);
+        check(r->id == 0x100 * (r->core + 1) + r->seq && r->arg == r->seq * 3);
+        if (i) check(r->time >= r[-1].time);
+    }
+    check(next[0] == 100 && next[1] == 20);
+    free(file);
+}
+
+// repeated reads of the metadata come from the cache, the least recently used
+// sector going first
+static void test_cache(void) {
+    static uint8_t mbr[VD_HOST_SECTOR_SIZE];
+    vd_cache_flush();
+    struct vd_cache_stats before = vd_cache_stats;
+    memcpy(mbr, read_sector(0), sizeof(mbr));
+    check(!memcmp(read_sector(0), mbr, sizeof(mbr)));
+    check(vd_cache_stats.hits == before.hits + 1 && vd_cache_stats.misses == before.misses + 1);
+    for (uint32_t lba = 1; lba <= 8; lba++) read_sector(lba);
+    check(vd_cache_stats.misses == before.misses + 9);
+    read_sector(8);
+    check(vd_cache_stats.hits == before.hits + 2);
+    check(!memcmp(read_sector(0), mbr, sizeof(mbr)));
+    check(vd_cache_stats.misses == before.misses + 10);
+}
+
+static void test_ring(void) {
+    uint32_t size;
+    uint8_t *file = read_file("CRASH001BIN", &size);
+    check(size == CRASH_RING_FILE_SIZE);
+    const struct crash_ring_header *header = (const struct crash_ring_header *) file;
+    check(header->magic == CRASH_RING_MAGIC && header->seq == 7 && header->block_addr == BLOCK_ADDR);
+    for (uint32_t i = 0; i < CRASH_RING_DATA_SIZE; i++) {
+        check(file[CRASH_RING_FILE_HEADER_SIZE + i] == (i < CRASH_RING_PAGE_SIZE ? 0x5a : 0));
+    }
+    free(file);
+}
+
+static void test_xxd_resumes(void) {
+    const uint8_t *e = find("CRASHDMPXXD");
+    uint32_t size = le32(e + 28), first = cluster_sector(le16(e + 26));
+    check(size == 4 * CRASH_RING_DATA_SIZE);
+    check(!memcmp(read_sector(first), "00000 4865 6c6c 6f2c 2063 7261 7368 210a 0e0f  Hello, crash!...\n", 64));
+    // the key is sensitive
+    check(!memcmp(read_sector(first) + 128, "00020 ---- ---- 2425 2627 2829 2a2b 2c2d 2e2f  ----$%&'()*+,-./\n", 64));
+    check(!vd_host_events.reboots);
+    // all but the last sector, some more than once
+    for (uint32_t lba = first; lba < first + size / VD_HOST_SECTOR_SIZE - 1; lba++) read_sector(lba);
+    read_sector(first);
+    check(!vd_host_events.reboots);
+    read_sector(first + size / VD_HOST_SECTOR_SIZE - 1);
+    check(vd_host_events.reboots == 1);
+    check(vd_host_events.reboot_delay_ms == AUTO_RESUME_DELAY_MS);
+    // only once
+    read_sector(first);
+    vd_eject();
+    check(vd_host_events.reboots == 1);
+}
+
+static void test_uf2_hands_over(void) {
+    uint8_t block[VD_HOST_SECTOR_SIZE] = {0};
+    struct uf2_block *uf2 = (struct uf2_block *) block;
+    uf2->magic_start0 = UF2_MAGIC_START0;
+    uf2->magic_start1 = UF2_MAGIC_START1;
+    uf2->magic_end = UF2_MAGIC_END;
+    uf2->flags = UF2_FLAG_FAMILY_ID_PRESENT;
+    uf2->file_size = RP2040_FAMILY_ID;
+    uf2->target_addr = SRAM_BASE;
+    uf2->payload_size = 256;
+    uf2->num_blocks = 1;
+    check(!vd_host_write_block(0, 1000, block));
+    check(vd_host_events.usb_boots == 1);
+    // anything else is ignored
+    block[0] ^= 1;
+    check(!vd_host_write_block(0, 1000, block));
+    check(vd_host_events.usb_boots == 1);
+}
+
+// the log_fmt section, as the build dumps it from the image
+extern const char __start_log_fmt[], __stop_log_fmt[];
+
+static char *log_text(uint32_t *lost) {
+    uint32_t size;
+    uint8_t *file = read_file("LOG     BIN", &size);
+    check(size == sizeof(struct log_ring) && !log_check(file, size));
+    struct log_decode_image image = {.formats = __start_log_fmt, .formats_size = __stop_log_fmt - __start_log_fmt};
+    static char text[64 * 1024];
+    FILE *f = fmemopen(text, sizeof(text), "w");
+    check(log_print(f, file, &image));
+    fclose(f);
+    *lost = ((const struct log_ring *) file)->lost;
+    free(file);
+    return text;
+}
+
+static void test_log(void) {
+    // written by test_uf2_hands_over
+    uint32_t lost;
+    char *text = log_text(&lost);
+    check(!lost);
+    check(strstr(text, " Sector 1000: ignoring write of non UF2 sector\n"));
+    // going round, it loses whole entries
+    uint8_t block[VD_HOST_SECTOR_SIZE] = {0};
+    for (uint32_t lba = 0; lba < LOG_RING_WORDS; lba++) vd_host_write_block(0, lba, block);
+    text = log_text(&lost);
+    check(lost);
+    check(strstr(text, " Sector 511: ignoring write of non UF2 sector\n"));
+    check(!strstr(text, "makes no sense"));
+}
+
+static void test_uf2_replays(void) {
+    // (test_xxd_resumes went back to the application)
+    vd_host_set_crash(BLOCK_ADDR);
+    uint32_t size;
+    uint8_t *file = read_file("CRASHDMPUF2", &size);
+    check(size == 264 * 1024 / 256 * VD_HOST_SECTOR_SIZE);
+    const struct uf2_block *uf2 = (const struct uf2_block *) file;
+    check(uf2->magic_start0 == UF2_MAGIC_START0 && uf2->magic_start1 == UF2_MAGIC_START1 &&
+          uf2->magic_end == UF2_MAGIC_END);
+    check(uf2->file_size == RP2040_FAMILY_ID && uf2->target_addr == SRAM_BASE && uf2->payload_size == 256);
+    check(uf2->block_no == 0 && uf2->num_blocks == size / VD_HOST_SECTOR_SIZE);
+    check(!memcmp(uf2->data, "Hello, crash!\n", 14));
+    // the key is sensitive
+    check(!memcmp(uf2->data + 0x20, "\0\0\0\0\x24", 5));
+    const uint32_t *tag = (const uint32_t *) (uf2->data + 256);
+    check((tag[0] & 0xff) == 8 && tag[1] == BLOCK_ADDR);
+    uf2 = (const struct uf2_block *) (file + size - VD_HOST_SECTOR_SIZE);
+    check(uf2->target_addr == SRAM_END - 256 && uf2->block_no == uf2->num_blocks - 1);
+
+    // dragged back, it stays here (rather than going to the real bootrom)
+    // and comes back up in dump mode, without going back to the application
+    struct crashdump_block *block = (struct crashdump_block *) BLOCK_ADDR;
+    block->resume_vector = XIP_BASE + TEXT_FLASH_OFFSET;
+    watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] = 0;
+    unsigned int usb_boots = vd_host_events.usb_boots, reboots = vd_host_events.reboots;
+    for (uint32_t n = 0; n < size / VD_HOST_SECTOR_SIZE; n++) {
+        check(vd_host_write_block(0, 2000 + n, file + n * VD_HOST_SECTOR_SIZE));
+    }
+    check(vd_host_events.usb_boots == usb_boots);
+    check(vd_host_events.reboots == reboots + 1);
+    check(watchdog_hw->scratch[CRASHDUMP_SCRATCH_MAGIC] == CRASHDUMP_MAGIC);
+    check(watchdog_hw->scratch[CRASHDUMP_SCRATCH_BLOCK] == BLOCK_ADDR);
+    check(!block->resume_vector);
+    free(file);
+}
+
+int main(void) {
+    check(vd_host_map());
+    make_crash();
+    make_ring();
+    vd_init();
+    vd_reset();
+
+    test_layout();
+    test_regs();
+    test_cache();
+    test_stats();
+    test_minidump();
+    test_backtrace();
+    test_usage();
+    test_trace();
+    test_ring();
+    test_xxd_resumes();
+    test_uf2_hands_over();
+    test_log();
+    test_uf2_replays();
+    // (printf is the device's, with USE_LOG)
+    fprintf(stdout, "vd_host_test: ok\n");
+    return 0;
+}
@@ -37,6 +37,23 @@ asm (
 ".hword impl_msc_on_sector_stream_chunk + 1\n"
 #ifdef USE_PICOBOOT
 ".hword impl_picoboot_on_stream_chunk + 1\n"
+#elif defined(USE_GDB_STUB)
+".hword _dead + 1\n" // should not be called
+#endif
+#ifdef USE_GDB_STUB
+".hword impl_gdb_stub_cmd_packet + 1\n"
+".hword impl_gdb_stub_reply_packet + 1\n"
+#elif defined(USE_PICOBOOT_DUMP)
+".hword _dead + 1\n" // should not be called
+".hword _dead + 1\n" // should not be called
+#endif
+#ifdef USB_LARGE_DESCRIPTOR_SIZE
+".hword impl_usb_stream_noop_on_chunk + 1\n"
+#elif defined(USE_PICOBOOT_DUMP)
+".hword _dead + 1\n" // should not be called
+#endif
+#ifdef USE_PICOBOOT_DUMP
+".hword impl_picoboot_dump_on_chunk + 1\n"
 #endif
 );
 #endif
@@ -100,6 +117,12 @@ void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {
     rebooting = true;
 }
 
+// Undo a watchdog_reboot which hasn't happened yet
+void watchdog_reboot_cancel() {
+    hw_clear_bits(&watchdog_hw->ctrl, WATCHDOG_CTRL_ENABLE_BITS);
+    rebooting = false;
+}
+
 #endif
 
 #ifdef USE_BOOTROM_GPIO
@@ -16,7 +16,14 @@
 // allow usb_boot to not include all interfaces
 #define USB_BOOT_WITH_SUBSET_OF_INTERFACES
 // use a fixed number of interfaces to save code
+#ifdef USE_GDB_STUB
+// and the gdb stub's CDC-ACM pair
+#define USB_FIXED_INTERFACE_COUNT 4
+// whose descriptors take the configuration past one control packet
+#define USB_LARGE_DESCRIPTOR_SIZE 128
+#else
 #define USB_FIXED_INTERFACE_COUNT 2
+#endif
 #else
 #define USB_FIXED_INTERFACE_COUNT 1
 #endif
@@ -44,6 +51,16 @@
 #ifdef USE_PICOBOOT
 #define ROM_FUNC_picoboot_on_stream_chunk 6
 #endif
+#ifdef USE_GDB_STUB
+#define ROM_FUNC_gdb_stub_cmd_packet 7
+#define ROM_FUNC_gdb_stub_reply_packet 8
+#endif
+#ifdef USB_LARGE_DESCRIPTOR_SIZE
+#define ROM_FUNC_usb_stream_noop_on_chunk 9
+#endif
+#ifdef USE_PICOBOOT_DUMP
+#define ROM_FUNC_picoboot_dump_on_chunk 10
+#endif
 
 extern uint8_t _rom_functions[];
 #endif
@@ -62,6 +79,7 @@ extern void *__memcpy(void *dest, const void *src, uint n);
 extern void memset0(void *dest, uint count);
 void interrupt_enable(uint int_num, bool enable);
 void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms);
+void watchdog_reboot_cancel();
 extern bool watchdog_rebooting();
 
 #ifdef USE_BOOTROM_GPIO
@@ -72,11 +90,20 @@ extern uint32_t usb_activity_gpio_pin_mask;
 
 #ifndef USB_BOOT_EXPANDED_RUNTIME
 #define usb_trace(format, ...) ((void)0)
+#ifdef USE_LOG
+// formatted by the host, from LOG.BIN (log.h)
+#include "log.h"
+#define usb_debug(format, ...) log_defer(LOG_DEBUG, format, ##__VA_ARGS__)
+#define usb_warn(format, ...) log_defer(LOG_WARN, format, ##__VA_ARGS__)
+#define uf2_debug(format, ...) log_defer(LOG_UF2, format, ##__VA_ARGS__)
+#define printf(format, ...) log_defer(LOG_PRINT, format, ##__VA_ARGS__)
+#else
 #define usb_debug(format, ...) ((void)0)
 #define usb_warn(format, ...) ((void)0)
-#define usb_panic(format, ...) __breakpoint()
 #define uf2_debug(format, ...) ((void)0)
 #define printf(format, ...) ((void)0)
+#endif
+#define usb_panic(format, ...) __breakpoint()
 #define puts(str) ((void)0)
 
 extern uint32_t ctz32(uint32_t x);
@@ -260,14 +260,18 @@ static void _usb_endpoint_hw_init(struct usb_endpoint *ep, __unused uintptr_t da
                        | (ep->descriptor->bmAttributes << EP_CTRL_BUFFER_TYPE_LSB);
 #else
                        | (USB_TRANSFER_TYPE_BULK << EP_CTRL_BUFFER_TYPE_LSB);
-                       assert(ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_BULK);
+                       // an interrupt endpoint is only allowed if it is never used
+                       assert(ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_BULK ||
+                              ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_INTERRUPT);
 #endif
 #else
         static_assert(EP_CTRL_ENABLE_BITS >> 25u, "");
         static_assert(EP_CTRL_INTERRUPT_PER_BUFFER >> 25u, "");
         static_assert(EP_CTRL_DOUBLE_BUFFERED_BITS >> 25u, "");
         static_assert(EP_CTRL_BUFFER_TYPE_LSB >= 25u, "");
-        assert(ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_BULK);
+        // an interrupt endpoint is only allowed if it is never used
+        assert(ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_BULK ||
+               ep->descriptor->bmAttributes == USB_TRANSFER_TYPE_INTERRUPT);
         // weird... the compiler doesn't actually do this, but still produces better code than the above!
         uint32_t reg = (EP_CTRL_ENABLE_BITS | EP_CTRL_INTERRUPT_PER_BUFFER |
                         (USB_TRANSFER_TYPE_BULK << EP_CTRL_BUFFER_TYPE_LSB)) >> 25u;
@@ -773,7 +777,7 @@ static void _usb_default_handle_device_setup_request(struct usb_setup_packet *se
         if (setup->bmRequestType & USB_DIR_IN) {
             struct usb_buffer *in_packet = usb_current_in_packet_buffer(&usb_control_in);
             uint8_t *buf = in_packet->data;
-            uint buf_len = in_packet->data_max;
+            __unused uint buf_len = in_packet->data_max;
             int len = -1;
 
             switch (setup->bRequest) {
@@ -1162,7 +1166,7 @@ void usb_reset_trace(void)
 }
 #endif
 
-#ifdef USB_BOOT_EXPANDED_RUNTIME
+#if defined(USB_BOOT_EXPANDED_RUNTIME) || defined(USE_LOG)
 const char *usb_endpoint_dir_string(struct usb_endpoint *ep) {
     return _in_out_string(ep->in);
 }
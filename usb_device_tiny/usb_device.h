@@ -30,7 +30,8 @@
 // since our device has on_configure, require it so save a null test
 #define USB_MUST_HAVE_DEVICE_ON_CONFIGURE
 
-// since all our non 0 endpoints are bulk, require that to allow compile time constants
+// since all our non 0 endpoints are bulk, require that to allow compile time constants (the gdb stub's CDC
+// notification endpoint is interrupt, but is never armed, so is set up as bulk too)
 #define USB_BULK_ONLY_EP1_THRU_16
 
 // our interfaces are zero based number in the order they appear on the device - require that
@@ -295,6 +295,7 @@ static void _scsi_handle_start_stop_unit(const struct scsi_cbw *cbw) {
     if (2u == (cbw->cb[4] & 3u)) {
         usb_warn("EJECT immed %02x\n", cbw->cb[1]);
         msc_eject();
+        vd_eject();
     }
     return _msc_init_for_dn(cbw);
 }
@@ -303,9 +304,8 @@ static void _scsi_handle_read_or_write_command(const struct scsi_cbw *cbw, enum
     const struct scsi_read_cb *cb = (const struct scsi_read_cb *) &cbw->cb[0];
     uint32_t lba = __builtin_bswap32(cb->lba);
     uint16_t blocks = __builtin_bswap16(cb->blocks);
-    usb_debug(dir == SCSI_DIR_IN ? "Read %d blocks starting at lba %ld\n" :
-              "Write %d blocks starting at lba %ld\n",
-              blocks, lba);
+    // one format, as the deferred log needs literal ones
+    usb_debug("%s %d blocks starting at lba %ld\n", dir == SCSI_DIR_IN ? "Read" : "Write", blocks, lba);
     _scsi_read_or_write_blocks(cbw, lba, blocks, dir);
 }
 
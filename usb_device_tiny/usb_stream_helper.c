@@ -127,7 +127,15 @@ void usb_stream_setup_transfer(struct usb_stream_transfer *transfer, const struc
     usb_grow_transfer(&transfer->core, (transfer_length + 63) / 64);
 }
 
-#ifdef USB_BOOT_EXPANDED_RUNTIME
+#ifndef USB_BOOT_EXPANDED_RUNTIME
+// for a chunk buffer that is filled before the transfer starts (not _noop,
+// which would leave chunk_len as the result)
+__rom_function_static_impl(bool, _usb_stream_noop_on_chunk)(__unused uint32_t chunk_len
+                                                             __comma_removed_for_space(
+                                                                     __unused struct usb_stream_transfer *transfer)) {
+    return false;
+}
+#else
 void usb_stream_noop_on_packet_complete(__removed_for_space(__unused struct usb_stream_transfer *transfer)) {}
 bool usb_stream_noop_on_chunk(uint32_t size __comma_removed_for_space(__unused struct usb_stream_transfer *transfer)) {
     return false;
@@ -43,7 +43,9 @@ void usb_stream_chunk_done(struct usb_stream_transfer *transfer);
 #ifndef USB_BOOT_EXPANDED_RUNTIME
 extern void _noop();
 #define usb_stream_noop_on_packet_complete ((stream_on_packet_complete_function)_noop)
-#define usb_stream_noop_on_chunk needs_work
+__rom_function_static_impl(bool, _usb_stream_noop_on_chunk)(uint32_t chunk_len
+                                                             __comma_removed_for_space(struct usb_stream_transfer *transfer));
+#define usb_stream_noop_on_chunk __rom_function_ref(_usb_stream_noop_on_chunk)
 #else
 void usb_stream_noop_on_packet_complete(__removed_for_space(struct usb_stream_transfer *transfer));
 bool usb_stream_noop_on_chunk(uint32_t chunk_len __comma_removed_for_space( struct usb_stream_transfer *transfer));
@@ -13,6 +13,8 @@
 
 void vd_init();
 void vd_reset();
+// the host ejected us
+void vd_eject();
 
 // return true for async operation
 bool vd_read_block(uint32_t token, uint32_t lba, uint8_t *buf __comma_removed_for_space(uint32_t buf_size));
@@ -26,14 +28,32 @@ bool vd_write_block(uint32_t token, uint32_t lba, uint8_t *buf __comma_removed_f
 
 #define SECTOR_COUNT (VOLUME_SIZE / SECTOR_SIZE)
 
-#ifndef GENERAL_SIZE_HACKS
-static inline uint32_t vd_sector_count() {
-    return SECTOR_COUNT;
-}
-#else
-// needs to be a compile time constant
+// needs to be a compile time constant (usb_msc.c's static responses), with or
+// without GENERAL_SIZE_HACKS
 #define vd_sector_count() SECTOR_COUNT
-#endif
 
 void vd_async_complete(uint32_t token, uint32_t result);
+
+// Forget everything in the XIP overlay (xip_arena.h), as the UF2 bitmaps are
+// about to be used, or what the disk shows may have changed
+void vd_overlay_flush();
+
+// word as nibbles lower case hex digits, for the text files
+void hex(uint8_t *buf, uint32_t word, uint8_t nibbles);
+
+#ifdef USE_VD_CACHE
+// of metadata, in the XIP overlay (xip_arena.h)
+#define VD_CACHE_SECTORS 8
+
+// Hits and misses of the metadata sector cache (virtual_disk.c)
+struct vd_cache_stats {
+    uint32_t hits;
+    uint32_t misses;
+};
+extern struct vd_cache_stats vd_cache_stats;
+
+// Forget what the cache holds, as what the disk shows may have changed
+void vd_cache_flush();
+#endif
+
 #endif